@@ -0,0 +1,74 @@
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+
+#include "parser_context.h"
+
+/* frontend throughput (scan, parse, semantic analysis, AST) on a generated
+ * translation unit, with and without building the parse tree. Logs are off
+ * so only tree construction differs. */
+
+static void write_source(const char *path, int functions) {
+  std::FILE *out = std::fopen(path, "w");
+  assert(out);
+  fmt::print(out, "int g[10];\n");
+  for (int i = 0; i < functions; i++) {
+    fmt::print(out,
+               "int f{0}(int a, int b) {{\n"
+               "  int x, y, i;\n"
+               "  x = a + b * 2;\n"
+               "  y = x - 3 % 2;\n"
+               "  if (x > y && y != 0) {{ x = x * y; }} else {{ y = y / 2; }}\n"
+               "  for (i = 0; i < 10; i++) {{ g[i] = g[i] + x; }}\n"
+               "  while (x < 100) {{ x = x + 1; }}\n"
+               "  return x + y;\n"
+               "}}\n",
+               i);
+  }
+  fmt::print(out,
+             "int main() {{\n  int s;\n  s = f0(1, 2);\n  return s;\n}}\n");
+  std::fclose(out);
+}
+
+static double run(const char *path, bool build_pt) {
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  {
+    ParserContext context(std::fopen(path, "r"));
+    context.logger()->disable();
+    context.ast_logger()->disable();
+    context.pt_logger()->disable();
+    context.error_logger()->disable();
+    context.build_pt(build_pt);
+    context.parse();
+  }
+  auto done = clock::now();
+  return std::chrono::duration<double, std::milli>(done - start).count();
+}
+
+int main(int argc, char **argv) {
+  int functions = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+  const char *path = "frontend_bench.c";
+  write_source(path, functions);
+
+  struct stat st;
+  stat(path, &st);
+  double mb = st.st_size / (1024.0 * 1024.0);
+
+  fmt::print("{} functions ({:.2f} MiB), best of {} runs\n", functions, mb,
+             reps);
+  for (bool build_pt : {true, false}) {
+    double best = 1e18;
+    for (int i = 0; i < reps; i++) {
+      best = std::min(best, run(path, build_pt));
+    }
+    fmt::print("parse tree {:3} {:9.2f} ms {:8.2f} MiB/s\n",
+               build_pt ? "on" : "off", best, mb / (best / 1000));
+  }
+}
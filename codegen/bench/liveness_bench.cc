@@ -0,0 +1,97 @@
+#include <chrono>
+#include <cstdlib>
+#include <fmt/core.h>
+
+#include "ir/ir_builder.h"
+
+/* per proc analysis (IRProc::process: flow graph, liveness fixpoints,
+ * next use, allocation) on generated procs: nested loops that keep many
+ * variables live around every back edge. visits counts the blocks the
+ * liveness solver evaluated. */
+
+class ProcBuilder : public IRBuilder {
+public:
+  ProcBuilder(int vars, int depth, int width)
+      : vars_(vars), depth_(depth), width_(width) {}
+
+  /* instructions of the generated proc, the proc is left open */
+  int generate() {
+    new_proc(get_global("f"));
+    for (int v = 1; v <= vars_; v++) {
+      instr(IRInstr(IROp::ALLOC, get_var(v)));
+      instr(IRInstr(IROp::COPY, get_var(v), IRArg(v)));
+    }
+    next_temp_ = vars_ + 1;
+    nest(0);
+    instr(IRInstr(IROp::RET, get_var(1)));
+    return instrs_;
+  }
+
+private:
+  void instr(IRInstr instr) {
+    last_label_ = std::nullopt;
+    add_instr(std::move(instr));
+    instrs_++;
+  }
+
+  IRVar *var() { return get_var(1 + next_random() % vars_); }
+  IRVar *temp() { return get_var(next_temp_++); }
+
+  /* deterministic, so every run analyses the same proc */
+  unsigned next_random() { return seed_ = seed_ * 1103515245 + 12345; }
+
+  void nest(int level) {
+    auto head = get_label(next_label_++);
+    auto exit = get_label(next_label_++);
+    add_label(head);
+    auto cond = temp();
+    instr(IRInstr(IROp::LESS, cond, var(), var()));
+    instr(IRInstr(IROp::JMPIFNOT, cond, exit));
+    for (int i = 0; i < width_; i++) {
+      auto t = temp();
+      instr(IRInstr(IROp::ADD, t, var(), var()));
+      instr(IRInstr(IROp::COPY, var(), t));
+      if (level < depth_ && i == width_ / 2) {
+        nest(level + 1);
+      }
+    }
+    instr(IRInstr(IROp::JMP, head));
+    add_label(exit);
+  }
+
+  int vars_, depth_, width_;
+  int next_temp_ = 1, next_label_ = 1;
+  int instrs_ = 0;
+  unsigned seed_ = 1;
+};
+
+int main(int argc, char **argv) {
+  int reps = argc > 1 ? std::atoi(argv[1]) : 5;
+
+  struct Config {
+    int vars, depth, width;
+  };
+  fmt::print("{:>6} {:>6} {:>8} {:>8} {:>8} {:>12}\n", "vars", "depth",
+             "instrs", "blocks", "visits", "process ms");
+  for (auto [vars, depth, width] :
+       {Config{100, 4, 20}, Config{1000, 8, 50}, Config{4000, 16, 100}}) {
+    double best = 1e18;
+    int instrs = 0;
+    size_t blocks = 0, visits = 0;
+    for (int i = 0; i < reps; i++) {
+      ProcBuilder builder(vars, depth, width);
+      instrs = builder.generate();
+      builder.end_proc();
+      auto &proc = builder.program()->procs().back();
+      auto start = std::chrono::steady_clock::now();
+      proc->process();
+      auto done = std::chrono::steady_clock::now();
+      best = std::min(
+          best, std::chrono::duration<double, std::milli>(done - start).count());
+      blocks = proc->blocks().size();
+      visits = proc->liveness_visits();
+    }
+    fmt::print("{:>6} {:>6} {:>8} {:>8} {:>8} {:>12.2f}\n", vars, depth,
+               instrs, blocks, visits, best);
+  }
+}
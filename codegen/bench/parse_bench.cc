@@ -0,0 +1,76 @@
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <memory>
+#include <string>
+
+#include "parser_context.h"
+
+/* parse + teardown time of a generated translation unit, arena ownership
+ * vs one heap block per token/node */
+
+static void write_source(const char *path, int functions) {
+  std::FILE *out = std::fopen(path, "w");
+  assert(out);
+  fmt::print(out, "int g[10];\n");
+  for (int i = 0; i < functions; i++) {
+    fmt::print(out,
+               "int f{0}(int a, int b) {{\n"
+               "  int x, y, i;\n"
+               "  x = a + b * 2;\n"
+               "  y = x - 3 % 2;\n"
+               "  if (x > y && y != 0) {{ x = x * y; }} else {{ y = y / 2; }}\n"
+               "  for (i = 0; i < 10; i++) {{ g[i] = g[i] + x; }}\n"
+               "  while (x < 100) {{ x = x + 1; }}\n"
+               "  return x + y;\n"
+               "}}\n",
+               i);
+  }
+  fmt::print(out,
+             "int main() {{\n  int s;\n  s = f0(1, 2);\n  return s;\n}}\n");
+  std::fclose(out);
+}
+
+struct Timing {
+  double parse = 0;
+  double teardown = 0;
+};
+
+static Timing run(const char *path, bool use_arena) {
+  using clock = std::chrono::steady_clock;
+  auto start = clock::now();
+  auto context =
+      std::make_unique<ParserContext>(std::fopen(path, "r"), use_arena);
+  context->set_logger_file("/dev/null");
+  context->set_error_logger_file("/dev/null");
+  context->parse();
+  auto parsed = clock::now();
+  context.reset();
+  auto done = clock::now();
+
+  auto ms = [](auto d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+  };
+  return {ms(parsed - start), ms(done - parsed)};
+}
+
+int main(int argc, char **argv) {
+  int functions = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int reps = argc > 2 ? std::atoi(argv[2]) : 5;
+  const char *path = "parse_bench.c";
+  write_source(path, functions);
+
+  fmt::print("{} functions, best of {} runs\n", functions, reps);
+  for (bool use_arena : {false, true}) {
+    Timing best{1e18, 1e18};
+    for (int i = 0; i < reps; i++) {
+      auto t = run(path, use_arena);
+      best.parse = std::min(best.parse, t.parse);
+      best.teardown = std::min(best.teardown, t.teardown);
+    }
+    fmt::print("{:6} parse {:9.2f} ms  teardown {:8.2f} ms\n",
+               use_arena ? "arena" : "heap", best.parse, best.teardown);
+  }
+}
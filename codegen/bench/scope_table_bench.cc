@@ -0,0 +1,133 @@
+#include <chrono>
+#include <cstdlib>
+#include <fmt/core.h>
+#include <string>
+#include <vector>
+
+#include "symbol_table.h"
+
+/* insert / lookup throughput of a single scope table with as many buckets as
+ * the parser gives each scope, then resolution of globals from nested
+ * scopes in both symbol table modes */
+
+struct Timing {
+  double insert = 0;
+  double hit = 0;
+  double miss = 0;
+};
+
+static Timing run(const std::vector<Name> &names,
+                  const std::vector<Name> &missing, int lookups) {
+  using clock = std::chrono::steady_clock;
+  ScopeTable table(10);
+
+  auto start = clock::now();
+  for (auto name : names) {
+    table.insert(name, SymbolType::VAR, nullptr);
+  }
+  auto inserted = clock::now();
+
+  size_t found = 0;
+  for (int r = 0; r < lookups; r++) {
+    for (auto name : names) {
+      found += table.look_up(name) != nullptr;
+    }
+  }
+  auto hits = clock::now();
+  for (int r = 0; r < lookups; r++) {
+    for (auto name : missing) {
+      found += table.look_up(name) != nullptr;
+    }
+  }
+  auto done = clock::now();
+
+  if (found != names.size() * lookups) {
+    fmt::print(stderr, "lookup mismatch\n");
+    std::exit(1);
+  }
+
+  /* ns per operation */
+  auto ns = [](auto d, size_t ops) {
+    return std::chrono::duration<double, std::nano>(d).count() / ops;
+  };
+  size_t ops = names.size() * lookups;
+  return {ns(inserted - start, names.size()), ns(hits - inserted, ops),
+          ns(done - hits, ops)};
+}
+
+/* ns per lookup of a global from the innermost of depth nested scopes, each
+ * declaring a few locals */
+static double run_nested(SymbolTable::Mode mode,
+                         const std::vector<Name> &globals, int depth,
+                         int lookups) {
+  using clock = std::chrono::steady_clock;
+  SymbolTable table(10, nullptr, mode);
+  for (auto name : globals) {
+    table.insert(name, SymbolType::VAR, nullptr);
+  }
+  for (int d = 0; d < depth; d++) {
+    table.enter_scope();
+    for (int k = 0; k < 4; k++) {
+      table.insert(fmt::format("local{}_{}", d, k), SymbolType::VAR, nullptr);
+    }
+  }
+
+  auto start = clock::now();
+  size_t found = 0;
+  for (int r = 0; r < lookups; r++) {
+    for (auto name : globals) {
+      found += table.look_up(name) != nullptr;
+    }
+  }
+  auto done = clock::now();
+
+  if (found != globals.size() * lookups) {
+    fmt::print(stderr, "lookup mismatch\n");
+    std::exit(1);
+  }
+  return std::chrono::duration<double, std::nano>(done - start).count() /
+         (globals.size() * lookups);
+}
+
+int main(int argc, char **argv) {
+  int reps = argc > 1 ? std::atoi(argv[1]) : 5;
+
+  fmt::print("best of {} runs, ns/op\n", reps);
+  fmt::print("{:>8} {:>9} {:>9} {:>9}\n", "symbols", "insert", "hit", "miss");
+  for (size_t n : {10, 1000, 100000}) {
+    std::vector<Name> names, missing;
+    for (size_t i = 0; i < n; i++) {
+      names.push_back(Interner::intern(fmt::format("sym{}", i)));
+      missing.push_back(Interner::intern(fmt::format("absent{}", i)));
+    }
+    /* keep the total amount of lookups roughly constant */
+    int lookups = std::max<int>(1, 1000000 / n);
+
+    Timing best{1e18, 1e18, 1e18};
+    for (int i = 0; i < reps; i++) {
+      auto t = run(names, missing, lookups);
+      best.insert = std::min(best.insert, t.insert);
+      best.hit = std::min(best.hit, t.hit);
+      best.miss = std::min(best.miss, t.miss);
+    }
+    fmt::print("{:>8} {:9.2f} {:9.2f} {:9.2f}\n", n, best.insert, best.hit,
+               best.miss);
+  }
+
+  std::vector<Name> globals;
+  for (size_t i = 0; i < 1000; i++) {
+    globals.push_back(Interner::intern(fmt::format("sym{}", i)));
+  }
+  fmt::print("\nglobal lookup from nested scopes, 1000 globals, ns/op\n");
+  fmt::print("{:>8} {:>11} {:>9}\n", "depth", "scope chain", "flat");
+  for (int depth : {1, 8, 32}) {
+    double best[2] = {1e18, 1e18};
+    for (int i = 0; i < reps; i++) {
+      best[0] = std::min(best[0], run_nested(SymbolTable::Mode::SCOPE_CHAIN,
+                                             globals, depth, 1000));
+      best[1] = std::min(
+          best[1], run_nested(SymbolTable::Mode::FLAT, globals, depth, 1000));
+    }
+    fmt::print("{:>8} {:11.2f} {:9.2f}\n", depth, best[0], best[1]);
+  }
+}
@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/core.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "codegen/8086/codegen_8086.h"
+#include "codegen/8086/preprocessor.h"
+#include "compile_cache.h"
+#include "ir/ir_builder.h"
+#include "ir/ir_gen.h"
+#include "log.h"
+#include "parse_utils.h"
+#include "parser_context.h"
+#include "symbol_table.h"
+#include "thread_pool.h"
+
+namespace {
+
+struct Options {
+  bool srcmap = false;
+  bool debug = false;
+  bool stats = false;
+  bool dump_ir = false;
+  bool pt = false;
+  /* keep the log and ast dumps of every unit in batch mode */
+  bool logs = false;
+  /* global register allocation, see RegAlloc */
+  bool reg_alloc = false;
+  /* passes run on the ir of each proc, see IRPasses */
+  IRPasses passes;
+  int jobs = 1;
+  /* directory of the compile cache, none if empty */
+  std::string cache_dir;
+};
+
+/* where the outputs of one unit go, nothing is written for empty paths */
+struct UnitFiles {
+  std::string asm_out;
+  std::string ir;
+  std::string log;
+  std::string ast;
+  std::string pt;
+  std::string err;
+  /* create err only if there is something to report */
+  bool lazy_err = false;
+};
+
+/* parses and compiles a unit */
+int compile_source(std::unique_ptr<SourceBuffer> source, const UnitFiles &files,
+                   const Options &opts, int jobs, CompileCache *cache) {
+  ParserContext context(std::move(source), built_in_headers);
+  auto set_file = [](Logger *logger, const std::string &path) {
+    if (path.empty()) {
+      logger->disable();
+    } else {
+      logger->set_out_file(path.c_str());
+    }
+  };
+  set_file(context.ast_logger(), files.ast);
+  if (opts.pt) {
+    context.set_pt_logger_file(files.pt.c_str());
+  }
+  set_file(context.logger(), files.log);
+  if (files.lazy_err) {
+    context.error_logger()->set_out_file_lazy(files.err.c_str());
+  } else {
+    context.set_error_logger_file(files.err.c_str());
+  }
+  context.build_pt(opts.pt);
+  context.parse();
+  context.print_ast();
+  context.print_pt();
+
+  /* ir goes straight into the builder, text is only a debug dump */
+  IRBuilder ir_builder;
+  IRGenerator ir_gen(&ir_builder, files.ir.empty() ? nullptr : files.ir.c_str());
+  ir_gen.generate(context.ast_root(), jobs);
+
+  CodeGen8086 codegen(ir_builder.program(), files.asm_out.c_str(),
+                      opts.srcmap, opts.debug);
+  codegen.set_cache(cache);
+  codegen.set_reg_alloc(opts.reg_alloc);
+  codegen.set_passes(opts.passes);
+  codegen.gen(jobs);
+  /* the analyses run with code generation */
+  if (opts.stats) {
+    ir_builder.program()->print_stats(stdout);
+    codegen.print_stats(stdout);
+  }
+  return context.error_count();
+}
+
+/* the outputs of a unit a cache entry keeps, by the name it keeps them
+ * under. A hit writes the same files the compile did, dumps included. */
+constexpr std::pair<const char *, std::string UnitFiles::*> ROLES[] = {
+    {"asm", &UnitFiles::asm_out},
+    {"ir", &UnitFiles::ir},
+    {"err", &UnitFiles::err},
+    {"log", &UnitFiles::log},
+    {"ast", &UnitFiles::ast}};
+
+std::optional<std::string> read_file(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return std::nullopt;
+  }
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+
+/* A unit's cache entry is its error count on the first line, then every
+ * file it wrote as "role size" on a line followed by the contents. */
+std::string pack_unit(const UnitFiles &files, int errors) {
+  auto entry = fmt::format("{}\n", errors);
+  for (auto [role, member] : ROLES) {
+    auto &path = files.*member;
+    bool written = !path.empty() &&
+                   (member != &UnitFiles::err || !files.lazy_err || errors);
+    if (written) {
+      auto data = read_file(path).value_or("");
+      entry += fmt::format("{} {}\n", role, data.size());
+      entry += data;
+    }
+  }
+  return entry;
+}
+
+/* writes the files of a packed entry, returns the unit's error count or
+ * nothing if the entry doesn't parse */
+std::optional<int> unpack_unit(std::string_view entry, const UnitFiles &files) {
+  auto line = [&] {
+    auto end = entry.find('\n');
+    auto str = std::string(entry.substr(0, end));
+    entry.remove_prefix(end == std::string_view::npos ? entry.size() : end + 1);
+    return str;
+  };
+  int errors;
+  if (std::sscanf(line().c_str(), "%d", &errors) != 1) {
+    return std::nullopt;
+  }
+  while (!entry.empty()) {
+    char role[8];
+    size_t size;
+    if (std::sscanf(line().c_str(), "%7s %zu", role, &size) != 2 ||
+        size > entry.size()) {
+      return std::nullopt;
+    }
+    for (auto [name, member] : ROLES) {
+      if (std::strcmp(name, role) == 0) {
+        std::ofstream out(files.*member, std::ios::binary);
+        out.write(entry.data(), size);
+      }
+    }
+    entry.remove_prefix(size);
+  }
+  return errors;
+}
+
+/* compiles one unit, returns its error count or -1 if the source
+ * couldn't be read */
+int compile(const char *in_file, const UnitFiles &files, const Options &opts,
+            int jobs, CompileCache *cache) {
+  auto source = std::make_unique<SourceBuffer>(in_file);
+  if (!source->valid()) {
+    return -1;
+  }
+  if (files.lazy_err) {
+    /* left from an earlier run */
+    std::remove(files.err.c_str());
+  }
+
+  /* the whole unit, if it was compiled before with the same flags. Asking
+   * for the parse tree always parses, and so does asking for stats, which
+   * describe the work of a compile. */
+  std::string key;
+  if (cache) {
+    key = CompileCache::hash(CompileCache::Kind::UNIT)
+              .add(built_in_headers)
+              .add(source->str())
+              .add(fmt::format("{} {} {} {} {} {} {} {} {} {}", opts.srcmap,
+                               opts.debug, opts.reg_alloc, opts.passes.ssa,
+                               opts.passes.sccp, opts.passes.dce,
+                               files.ir.empty(), files.log.empty(),
+                               files.ast.empty(), files.lazy_err))
+              .hex();
+    auto entry = opts.pt || opts.stats
+                     ? std::nullopt
+                     : cache->load(CompileCache::Kind::UNIT, key);
+    if (entry) {
+      if (auto errors = unpack_unit(*entry, files)) {
+        return *errors;
+      }
+      cache->reject(CompileCache::Kind::UNIT);
+    }
+  }
+
+  int errors = compile_source(std::move(source), files, opts, jobs, cache);
+  if (cache) {
+    cache->store(key, pack_unit(files, errors));
+  }
+  return errors;
+}
+
+/* path without its extension */
+std::string stem(std::string_view path) {
+  auto dot = path.rfind('.');
+  auto slash = path.rfind('/');
+  if (dot == std::string_view::npos ||
+      (slash != std::string_view::npos && dot < slash)) {
+    return std::string(path);
+  }
+  return std::string(path.substr(0, dot));
+}
+
+/* one path per line, blank lines are skipped */
+bool read_response_file(const char *path, std::vector<std::string> &sources) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  for (std::string line; std::getline(in, line);) {
+    auto start = line.find_first_not_of(" \t\r");
+    auto end = line.find_last_not_of(" \t\r");
+    if (start != std::string::npos) {
+      sources.push_back(line.substr(start, end - start + 1));
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+/* Single process compiler: C source -> in-memory IR -> 8086 assembly.
+ *
+ * With -i, compiles one file into base.asm with log.txt, ast.txt and
+ * err.txt in the working directory. Otherwise every source named on the
+ * command line or listed in an @response file is compiled in this one
+ * process, -j of them at a time, and each unit writes next to its source:
+ * stem.asm, stem.err if there were errors, stem.ir with --ir, stem.pt with
+ * --pt and stem.log/stem.ast with --logs. --stats only applies to -i.
+ * --regalloc keeps vars in registers across blocks. --ssa takes every proc
+ * through SSA form and back before generating it, --sccp propagates
+ * constants and folds branches on the way. --dce forwards copies and
+ * deletes the instructions whose results are never read.
+ *
+ * --cache dir keeps every unit's output, and every proc's assembly, in dir
+ * and reuses them on later runs; hits and misses are reported at the end. */
+int main(int argc, char **argv) {
+  const char *in_file = "../sample_input.txt";
+  std::vector<std::string> sources;
+  Options opts;
+  // set input and output from command line
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
+      in_file = argv[++i];
+    } else if (std::strcmp(argv[i], "-v") == 0) {
+      opts.srcmap = true;
+    } else if (std::strcmp(argv[i], "-d") == 0) {
+      opts.debug = true;
+    } else if (std::strcmp(argv[i], "--stats") == 0) {
+      opts.stats = true;
+    } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      opts.jobs = std::max(1, std::atoi(argv[++i]));
+    } else if (std::strcmp(argv[i], "--ir") == 0) {
+      opts.dump_ir = true;
+    } else if (std::strcmp(argv[i], "--pt") == 0) {
+      opts.pt = true;
+    } else if (std::strcmp(argv[i], "--logs") == 0) {
+      opts.logs = true;
+    } else if (std::strcmp(argv[i], "--regalloc") == 0) {
+      opts.reg_alloc = true;
+    } else if (std::strcmp(argv[i], "--ssa") == 0) {
+      opts.passes.ssa = true;
+    } else if (std::strcmp(argv[i], "--sccp") == 0) {
+      opts.passes.sccp = true;
+    } else if (std::strcmp(argv[i], "--dce") == 0) {
+      opts.passes.dce = true;
+    } else if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      opts.cache_dir = argv[++i];
+    } else if (argv[i][0] == '@') {
+      if (!read_response_file(argv[i] + 1, sources)) {
+        fmt::print(stderr, "Couldn't access response file: {}\n", argv[i] + 1);
+        return EXIT_FAILURE;
+      }
+    } else if (argv[i][0] != '-') {
+      sources.push_back(argv[i]);
+    }
+  }
+
+  std::optional<CompileCache> cache;
+  if (!opts.cache_dir.empty()) {
+    cache.emplace(opts.cache_dir);
+  }
+  auto report = [&] {
+    if (cache) {
+      cache->print_stats(stderr);
+    }
+  };
+
+  if (sources.empty()) {
+    auto base = std::string(base_name(in_file));
+    UnitFiles files{.asm_out = base + ".asm",
+                    .ir = opts.dump_ir ? base + ".ir" : "",
+                    .log = "log.txt",
+                    .ast = "ast.txt",
+                    .pt = "pt.txt",
+                    .err = "err.txt"};
+    if (compile(in_file, files, opts, opts.jobs, cache ? &*cache : nullptr) <
+        0) {
+      fmt::print(stderr, "Couldn't access input file: {}\n", in_file);
+      return EXIT_FAILURE;
+    }
+    report();
+    return 0;
+  }
+
+  /* units run concurrently, each on a single thread; they share the
+   * process, its interned names and the pool's threads */
+  opts.stats = false; // would interleave
+  std::vector<int> errors(sources.size());
+  ThreadPool pool(opts.jobs);
+  pool.run(sources.size(), [&](size_t i) {
+    auto base = stem(sources[i]);
+    UnitFiles files{.asm_out = base + ".asm",
+                    .ir = opts.dump_ir ? base + ".ir" : "",
+                    .log = opts.logs ? base + ".log" : "",
+                    .ast = opts.logs ? base + ".ast" : "",
+                    .pt = base + ".pt",
+                    .err = base + ".err",
+                    .lazy_err = true};
+    errors[i] =
+        compile(sources[i].c_str(), files, opts, 1, cache ? &*cache : nullptr);
+  });
+
+  int failed = 0;
+  for (size_t i = 0; i < sources.size(); i++) {
+    if (errors[i] < 0) {
+      fmt::print(stderr, "Couldn't access input file: {}\n", sources[i]);
+      failed++;
+    } else if (errors[i] > 0) {
+      fmt::print(stderr, "{}: {} error(s), see {}.err\n", sources[i],
+                 errors[i], stem(sources[i]));
+    }
+  }
+  report();
+  return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* Bump allocator owning everything created for one translation unit.
+ * Memory is handed out from large chunks and released all at once when the
+ * arena dies. Destructors are only recorded (and run, newest first) for
+ * types that aren't trivially destructible.
+ *
+ * With bump = false every allocation is a separate heap block freed one by
+ * one on destruction, which is the old new/delete ownership model; it's
+ * kept around for benchmarking. */
+class Arena {
+public:
+  static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+  Arena(bool bump = true) : bump_(bump) {}
+  ~Arena() { clear(); }
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  bool bump() const { return bump_; }
+  size_t bytes_allocated() const { return bytes_allocated_; }
+
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    bytes_allocated_ += size;
+    if (!bump_) {
+      void *p = ::operator new(size, std::align_val_t(align));
+      heap_blocks_.push_back({p, align});
+      return p;
+    }
+    auto p = (ptr_ + (align - 1)) & ~uintptr_t(align - 1);
+    if (p + size > end_) {
+      new_chunk(size + align);
+      p = (ptr_ + (align - 1)) & ~uintptr_t(align - 1);
+    }
+    ptr_ = p + size;
+    return reinterpret_cast<void *>(p);
+  }
+
+  template <class T, class... Args> T *create(Args &&...args) {
+    void *mem = allocate(sizeof(T), alignof(T));
+    T *obj = new (mem) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      dtors_.push_back({[](void *p) { static_cast<T *>(p)->~T(); }, obj});
+    }
+    return obj;
+  }
+
+  /* copy of str owned by the arena, nul terminated */
+  std::string_view copy_string(std::string_view str) {
+    char *mem = static_cast<char *>(allocate(str.size() + 1, 1));
+    std::memcpy(mem, str.data(), str.size());
+    mem[str.size()] = '\0';
+    return std::string_view(mem, str.size());
+  }
+
+  /* run destructors and release all memory */
+  void clear() {
+    for (auto it = dtors_.rbegin(); it != dtors_.rend(); ++it) {
+      it->destroy(it->obj);
+    }
+    dtors_.clear();
+    for (auto &block : heap_blocks_) {
+      ::operator delete(block.ptr, std::align_val_t(block.align));
+    }
+    heap_blocks_.clear();
+    while (chunk_) {
+      auto next = chunk_->next;
+      ::operator delete(chunk_);
+      chunk_ = next;
+    }
+    ptr_ = end_ = 0;
+    bytes_allocated_ = 0;
+  }
+
+  /* arena AST nodes are allocated from while parsing on this thread */
+  static Arena *current() { return current_; }
+  static Arena *set_current(Arena *arena) {
+    return std::exchange(current_, arena);
+  }
+
+private:
+  struct Chunk {
+    Chunk *next;
+  };
+
+  struct Dtor {
+    void (*destroy)(void *);
+    void *obj;
+  };
+
+  struct HeapBlock {
+    void *ptr;
+    size_t align;
+  };
+
+  void new_chunk(size_t min_size) {
+    size_t size = std::max(CHUNK_SIZE, min_size + sizeof(Chunk));
+    auto chunk = static_cast<Chunk *>(::operator new(size));
+    chunk->next = chunk_;
+    chunk_ = chunk;
+    ptr_ = reinterpret_cast<uintptr_t>(chunk) + sizeof(Chunk);
+    end_ = reinterpret_cast<uintptr_t>(chunk) + size;
+  }
+
+  bool bump_;
+  Chunk *chunk_ = nullptr;
+  uintptr_t ptr_ = 0;
+  uintptr_t end_ = 0;
+  size_t bytes_allocated_ = 0;
+
+  std::vector<Dtor> dtors_;
+  std::vector<HeapBlock> heap_blocks_;
+
+  static inline thread_local Arena *current_ = nullptr;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 /* base AST class */
+#include "arena.h"
 #include "ast/ast_visitor.h"
 #include "location.h"
 
@@ -13,6 +14,27 @@ public:
 
   virtual void visit(ASTVisitor *visitor) = 0;
 
+  /* nodes live in the current arena while parsing, deleting one only runs
+   * its destructor; a small header tells heap nodes apart */
+  static void *operator new(size_t size) {
+    auto arena = Arena::current();
+    bool in_arena = arena && arena->bump();
+    void *mem = in_arena ? arena->allocate(size + HEADER_SIZE)
+                         : ::operator new(size + HEADER_SIZE);
+    *static_cast<bool *>(mem) = in_arena;
+    return static_cast<char *>(mem) + HEADER_SIZE;
+  }
+
+  static void operator delete(void *ptr) {
+    void *mem = static_cast<char *>(ptr) - HEADER_SIZE;
+    if (!*static_cast<bool *>(mem)) {
+      ::operator delete(mem);
+    }
+  }
+
 protected:
   Location loc_;
+
+private:
+  static constexpr size_t HEADER_SIZE = alignof(std::max_align_t);
 };
@@ -237,11 +237,7 @@ void ASTPrinter::visit_float_literal(FloatLiteral *float_literal) {
   exit();
 }
 
-void ASTPrinter::space() {
-  for (int i = 0; i < depth_; i++) {
-    logger_->write(" ");
-  }
-}
+void ASTPrinter::space() { logger_->write("{:{}}", "", depth_); }
 
 void ASTPrinter::log_location(ASTNode *node) {
   auto &loc = node->location();
@@ -127,7 +127,7 @@ FuncDecl::create(ParserContext *context, Location loc, Type *ret_type,
   }
 
   if (!sym) {
-    context->global_scope()->insert(name, SymbolType::FUNC, ret);
+    context->insert_global_symbol(name, SymbolType::FUNC, ret);
   }
 
   return std::unique_ptr<FuncDecl>(ret);
@@ -5,6 +5,7 @@
 #include "ast/type.h"
 
 #include <cassert>
+#include <charconv>
 #include <iterator>
 
 #include "parser_context.h"
@@ -631,24 +632,25 @@ Type *BinaryExpr::determine_type(ParserContext *context, BinaryOp op_,
 
 ValueType BinaryExpr::determine_value_type() { return ValueType::RVALUE; }
 
-RefExpr::RefExpr(ParserContext *context, Location loc, Decl *decl,
-                 std::string name, Type *type, ValueType value_type)
-    : decl_(decl), Expr(loc, type, value_type), name_(std::move(name)) {}
+RefExpr::RefExpr(ParserContext *context, Location loc, Decl *decl, Name name,
+                 Type *type, ValueType value_type)
+    : decl_(decl), Expr(loc, type, value_type), name_(name) {}
 
 std::unique_ptr<Expr> RefExpr::create(ParserContext *context, Location loc,
                                       Token *token) {
-  std::string name = token->value();
+  Name name = token->name();
   Decl *decl = context->lookup_decl(name);
 
   if (!decl) {
-    context->report_error(loc, "Use of undeclared identifier '{}'", name);
+    context->report_error(loc, "Use of undeclared identifier '{}'",
+                          name.str());
     auto ret = new RecoveryExpr(context, loc);
     return std::unique_ptr<Expr>(ret);
   }
   auto type = determine_type(decl);
   auto value_type = determine_value_type(decl);
   return std::unique_ptr<Expr>(
-      new RefExpr(context, loc, decl, std::move(name), type, value_type));
+      new RefExpr(context, loc, decl, name, type, value_type));
 }
 
 Type *RefExpr::determine_type(Decl *decl) { return decl->type(); }
@@ -828,7 +830,9 @@ IntLiteral::IntLiteral(ParserContext *context, Location loc, int value)
 
 std::unique_ptr<Expr> IntLiteral::create(ParserContext *context, Location loc,
                                          Token *tok) {
-  int value = std::atoi(tok->value().c_str());
+  auto str = tok->value();
+  int value = 0;
+  std::from_chars(str.data(), str.data() + str.size(), value);
 
   return std::unique_ptr<Expr>(new IntLiteral(context, loc, value));
 }
@@ -841,7 +845,7 @@ CharLiteral::CharLiteral(ParserContext *context, Location loc, int value)
 std::unique_ptr<Expr> CharLiteral::create(ParserContext *context, Location loc,
                                           Token *tok) {
   auto val = tok->value();
-  int value = val[0];
+  int value = val.empty() ? 0 : val[0];
 
   return std::unique_ptr<Expr>(new CharLiteral(context, loc, value));
 }
@@ -853,7 +857,9 @@ FloatLiteral::FloatLiteral(ParserContext *context, Location loc, double value)
 
 std::unique_ptr<Expr> FloatLiteral::create(ParserContext *context, Location loc,
                                            Token *tok) {
-  auto value = std::atof(tok->value().c_str());
+  auto str = tok->value();
+  double value = 0;
+  std::from_chars(str.data(), str.data() + str.size(), value);
 
   return std::unique_ptr<Expr>(new FloatLiteral(context, loc, value));
 }
@@ -3,6 +3,7 @@
 #include "ast/ast_node.h"
 #include "ast/ast_visitor.h"
 #include "ast/type.h"
+#include "interner.h"
 
 #include <concepts>
 #include <memory>
@@ -184,7 +185,7 @@ private:
 /* reference to something */
 class RefExpr : public Expr {
 public:
-  RefExpr(ParserContext *context, Location loc, Decl *decl, std::string name,
+  RefExpr(ParserContext *context, Location loc, Decl *decl, Name name,
           Type *type, ValueType value_type);
 
   static std::unique_ptr<Expr> create(ParserContext *context, Location loc,
@@ -192,7 +193,7 @@ public:
 
   Decl *decl() { return decl_; }
 
-  std::string_view name() { return name_; }
+  std::string_view name() { return name_.str(); }
 
   void visit(ASTVisitor *visitor) override { visitor->visit_ref_expr(this); }
 
@@ -201,7 +202,7 @@ private:
   static ValueType determine_value_type(Decl *decl);
 
   Decl *decl_;
-  std::string name_;
+  Name name_;
 };
 
 class CallExpr : public Expr {
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fmt/core.h>
 #include <iostream>
@@ -8,12 +10,19 @@
 #include "parse_utils.h"
 
 #include "codegen/8086/codegen_8086.h"
+#include "compile_cache.h"
+#include "ir/ir_binary.h"
 #include "ir/ir_parser.h"
 
 int main(int argc, char **argv) {
   const char *in_file = "ir.txt";
   bool srcmap = false;
   bool debug = false;
+  bool stats = false;
+  bool reg_alloc = false;
+  IRPasses passes;
+  int jobs = 1;
+  const char *cache_dir = nullptr;
   // set input and output from command line
   for (int i = 1; i < argc; i++) {
     std::cerr << "[" << argv[i] << "]" << std::endl;
@@ -26,11 +35,68 @@ int main(int argc, char **argv) {
     if (std::strcmp(argv[i], "-d") == 0) {
       debug = true;
     }
+    if (std::strcmp(argv[i], "--stats") == 0) {
+      stats = true;
+    }
+    if (std::strcmp(argv[i], "--regalloc") == 0) {
+      reg_alloc = true;
+    }
+    if (std::strcmp(argv[i], "--ssa") == 0) {
+      passes.ssa = true;
+    }
+    if (std::strcmp(argv[i], "--sccp") == 0) {
+      passes.sccp = true;
+    }
+    if (std::strcmp(argv[i], "--dce") == 0) {
+      passes.dce = true;
+    }
+    if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      jobs = std::max(1, std::atoi(argv[i + 1]));
+    }
+    if (std::strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+      cache_dir = argv[i + 1];
+    }
+  }
+
+  /* only procs are cached here, the frontend decides the rest */
+  std::optional<CompileCache> cache;
+  if (cache_dir) {
+    cache.emplace(cache_dir);
   }
 
-  std::FILE *in = std::fopen(in_file, "r");
   auto out = std::string(base_name(in_file)) + ".asm";
 
+  if (IRBinaryReader::is_binary(in_file)) {
+    /* binary ir is replayed straight into the builder */
+    IRBinaryReader reader(in_file);
+    IRBuilder ir_builder;
+    if (!reader.valid() || !reader.read(&ir_builder)) {
+      fmt::print(stderr, "Malformed binary IR: {}\n", in_file);
+      return 1;
+    }
+    auto program = ir_builder.program();
+    std::cout << "globals : " << program->globals().size() << std::endl;
+    std::cout << "procs   : " << program->procs().size() << std::endl;
+    std::cout << "vars    : " << program->vars().size() << std::endl;
+
+    CodeGen8086 codegen(program, out.c_str(), srcmap, debug);
+    codegen.set_cache(cache ? &*cache : nullptr);
+    codegen.set_reg_alloc(reg_alloc);
+    codegen.set_passes(passes);
+    codegen.gen(jobs);
+    /* the analyses run with code generation */
+    if (stats) {
+      program->print_stats(stdout);
+      codegen.print_stats(stdout);
+    }
+    if (cache) {
+      cache->print_stats(stderr);
+    }
+    return 0;
+  }
+
+  std::FILE *in = std::fopen(in_file, "r");
+
   if (in) {
     /* parse ir */
     IRParser ir_parser(in);
@@ -41,7 +107,18 @@ int main(int argc, char **argv) {
     std::cout << "vars    : " << program->vars().size() << std::endl;
 
     CodeGen8086 codegen(ir_parser.program(), out.c_str(), srcmap, debug);
-    codegen.gen();
+    codegen.set_cache(cache ? &*cache : nullptr);
+    codegen.set_reg_alloc(reg_alloc);
+    codegen.set_passes(passes);
+    codegen.gen(jobs);
+    /* the analyses run with code generation */
+    if (stats) {
+      program->print_stats(stdout);
+      codegen.print_stats(stdout);
+    }
+    if (cache) {
+      cache->print_stats(stderr);
+    }
   } else {
     fmt::print(stderr, "Couldn't access input file: {}", in_file);
   }
@@ -0,0 +1,262 @@
+#include "asm_8086.h"
+
+#include <cassert>
+#include <charconv>
+
+std::string_view to_string(Op8086 op) {
+  switch (op) {
+  case Op8086::INT:
+    return "INT";
+  case Op8086::MOV:
+    return "MOV";
+  case Op8086::ADD:
+    return "ADD";
+  case Op8086::SUB:
+    return "SUB";
+  case Op8086::NEG:
+    return "NEG";
+  case Op8086::NOT:
+    return "NOT";
+  case Op8086::IMUL:
+    return "IMUL";
+  case Op8086::IDIV:
+    return "IDIV";
+  case Op8086::CWD:
+    return "CWD";
+  case Op8086::LEA:
+    return "LEA";
+  case Op8086::PUSH:
+    return "PUSH";
+  case Op8086::POP:
+    return "POP";
+  case Op8086::CALL:
+    return "CALL";
+  case Op8086::RET:
+    return "RET";
+  case Op8086::JG:
+    return "JG";
+  case Op8086::JGE:
+    return "JGE";
+  case Op8086::JL:
+    return "JL";
+  case Op8086::JLE:
+    return "JLE";
+  case Op8086::JE:
+    return "JE";
+  case Op8086::JNE:
+    return "JNE";
+  case Op8086::JMP:
+    return "JMP";
+  case Op8086::SAL:
+    return "SAL";
+  case Op8086::SAR:
+    return "SAR";
+  case Op8086::AND:
+    return "AND";
+  case Op8086::OR:
+    return "OR";
+  case Op8086::XOR:
+    return "XOR";
+  case Op8086::INC:
+    return "INC";
+  case Op8086::DEC:
+    return "DEC";
+  case Op8086::CMP:
+    return "CMP";
+  }
+  return "";
+}
+
+std::string_view to_string(Reg8086 reg) {
+  switch (reg) {
+  case Reg8086::NONE:
+    return "";
+  case Reg8086::AX:
+    return "AX";
+  case Reg8086::BX:
+    return "BX";
+  case Reg8086::CX:
+    return "CX";
+  case Reg8086::DX:
+    return "DX";
+  case Reg8086::SI:
+    return "SI";
+  case Reg8086::DI:
+    return "DI";
+  case Reg8086::BP:
+    return "BP";
+  case Reg8086::SP:
+    return "SP";
+  case Reg8086::DS:
+    return "DS";
+  case Reg8086::AH:
+    return "AH";
+  case Reg8086::CL:
+    return "CL";
+  }
+  return "";
+}
+
+Operand8086 Operand8086::label(int id) {
+  Operand8086 operand;
+  operand.kind = Kind::LABEL;
+  operand.value = id;
+  return operand;
+}
+
+Operand8086 Operand8086::symbol(std::string_view name) {
+  Operand8086 operand;
+  operand.kind = Kind::SYMBOL;
+  operand.name = name;
+  return operand;
+}
+
+Operand8086 Operand8086::mem(std::string_view name, Reg8086 index,
+                             int64_t disp) {
+  Operand8086 operand;
+  operand.kind = Kind::MEM;
+  operand.name = name;
+  operand.index = index;
+  operand.value = disp;
+  return operand;
+}
+
+Operand8086 Operand8086::mem(Reg8086 base, Reg8086 index, int64_t disp) {
+  Operand8086 operand;
+  operand.kind = Kind::MEM;
+  operand.reg = base;
+  operand.index = index;
+  operand.value = disp;
+  return operand;
+}
+
+void Asm8086::instr(Op8086 op, Operand8086 a, Operand8086 b) {
+  lines_.push_back({AsmLine8086::Kind::INSTR, op, {a, b}});
+}
+
+void Asm8086::label(int id) {
+  lines_.push_back(
+      {AsmLine8086::Kind::LABEL, Op8086::RET, {Operand8086::label(id)}});
+}
+
+void Asm8086::src_line(int line) {
+  lines_.push_back({AsmLine8086::Kind::SRC_LINE, Op8086::RET, {line}});
+}
+
+void Asm8086::comment(std::string text) {
+  lines_.push_back({AsmLine8086::Kind::COMMENT, Op8086::RET,
+                    {(int64_t)texts_.size()}});
+  texts_.push_back(std::move(text));
+}
+
+void Asm8086::text(std::string text) {
+  lines_.push_back(
+      {AsmLine8086::Kind::TEXT, Op8086::RET, {(int64_t)texts_.size()}});
+  texts_.push_back(std::move(text));
+}
+
+void Asm8086::epilogue() {
+  lines_.push_back({AsmLine8086::Kind::EPILOGUE, Op8086::RET, {}});
+}
+
+void Asm8086::append(Asm8086 &&other) {
+  int64_t base = texts_.size();
+  for (auto &line : other.lines_) {
+    if (line.kind == AsmLine8086::Kind::COMMENT ||
+        line.kind == AsmLine8086::Kind::TEXT) {
+      line.args[0].value += base;
+    }
+  }
+  lines_.insert(lines_.end(), other.lines_.begin(), other.lines_.end());
+  texts_.insert(texts_.end(), std::make_move_iterator(other.texts_.begin()),
+                std::make_move_iterator(other.texts_.end()));
+  other.lines_.clear();
+  other.texts_.clear();
+}
+
+static void write_int(std::string &out, int64_t value) {
+  char buf[24];
+  auto res = std::to_chars(buf, buf + sizeof(buf), value);
+  out.append(buf, res.ptr);
+}
+
+void Asm8086::write(std::string &out, const Operand8086 &operand) const {
+  /* the frame is laid out before anything is written */
+  assert(!operand.frame);
+  switch (operand.kind) {
+  case Operand8086::Kind::NONE:
+    break;
+  case Operand8086::Kind::REG:
+    out += to_string(operand.reg);
+    break;
+  case Operand8086::Kind::IMM:
+    write_int(out, operand.value);
+    break;
+  case Operand8086::Kind::LABEL:
+    out += 'L';
+    write_int(out, operand.value);
+    break;
+  case Operand8086::Kind::SYMBOL:
+    out += operand.name;
+    break;
+  case Operand8086::Kind::MEM:
+    out += "WORD PTR ";
+    out += operand.name;
+    out += '[';
+    if (operand.reg != Reg8086::NONE) {
+      out += to_string(operand.reg);
+      if (operand.index != Reg8086::NONE) {
+        out += '+';
+        out += to_string(operand.index);
+      }
+      if (operand.value >= 0) {
+        out += '+';
+      }
+      write_int(out, operand.value);
+    } else if (operand.index != Reg8086::NONE) {
+      out += to_string(operand.index);
+    } else {
+      write_int(out, operand.value);
+    }
+    out += ']';
+    break;
+  }
+}
+
+void Asm8086::write(std::string &out) const {
+  for (auto &line : lines_) {
+    switch (line.kind) {
+    case AsmLine8086::Kind::INSTR:
+      out += '\t';
+      out += to_string(line.op);
+      if (line.args[0].kind != Operand8086::Kind::NONE) {
+        out += ' ';
+        write(out, line.args[0]);
+      }
+      if (line.args[1].kind != Operand8086::Kind::NONE) {
+        out += ", ";
+        write(out, line.args[1]);
+      }
+      break;
+    case AsmLine8086::Kind::LABEL:
+      write(out, line.args[0]);
+      out += ": ";
+      break;
+    case AsmLine8086::Kind::SRC_LINE:
+      out += "; line #";
+      write_int(out, line.args[0].value);
+      break;
+    case AsmLine8086::Kind::COMMENT:
+      out += ';';
+      out += text_of(line);
+      break;
+    case AsmLine8086::Kind::TEXT:
+      out += text_of(line);
+      break;
+    case AsmLine8086::Kind::EPILOGUE:
+      assert(false && "epilogue not filled in");
+      break;
+    }
+    out += '\n';
+  }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class Op8086 : uint8_t {
+  INT,
+  MOV,
+  ADD,
+  SUB,
+  NEG,
+  AND,
+  OR,
+  XOR,
+  CWD,
+  INC,
+  DEC,
+  NOT,
+  CMP,
+  IMUL,
+  IDIV,
+  SAL,
+  SAR,
+  LEA,
+  PUSH,
+  POP,
+  CALL,
+  RET,
+  JG,
+  JGE,
+  JL,
+  JLE,
+  JE,
+  JNE,
+  JMP
+};
+
+std::string_view to_string(Op8086 op);
+
+enum class Reg8086 : uint8_t { NONE, AX, BX, CX, DX, SI, DI, BP, SP, DS, AH, CL };
+
+std::string_view to_string(Reg8086 reg);
+
+/* One operand of an instruction. Names point into the interner or are
+ * literals, so operands are plain values and copying them is free. */
+struct Operand8086 {
+  enum class Kind : uint8_t {
+    NONE,
+    REG,
+    IMM,
+    /* L<value> */
+    LABEL,
+    /* used as is: a proc, a global word, @DATA, 4CH */
+    SYMBOL,
+    /* WORD PTR name[index+disp] or WORD PTR [base+index+disp] */
+    MEM,
+  };
+
+  Operand8086() = default;
+  Operand8086(Reg8086 reg) : kind(Kind::REG), reg(reg) {}
+  Operand8086(int64_t imm) : kind(Kind::IMM), value(imm) {}
+
+  static Operand8086 label(int id);
+  static Operand8086 symbol(std::string_view name);
+  static Operand8086 mem(std::string_view name, Reg8086 index, int64_t disp);
+  static Operand8086 mem(Reg8086 base, Reg8086 index, int64_t disp);
+
+  bool is_reg(Reg8086 r) const { return kind == Kind::REG && reg == r; }
+
+  Kind kind = Kind::NONE;
+  /* register, or the base of a memory operand */
+  Reg8086 reg = Reg8086::NONE;
+  Reg8086 index = Reg8086::NONE;
+  /* value is a stack offset of the IR rather than a displacement from BP,
+   * until the frame is laid out */
+  bool frame = false;
+  /* immediate, displacement or label id */
+  int64_t value = 0;
+  /* symbol, or the array of a memory operand */
+  std::string_view name;
+};
+
+struct AsmLine8086 {
+  enum class Kind : uint8_t {
+    INSTR,
+    /* args[0] is the label */
+    LABEL,
+    /* args[0].value is the source line */
+    SRC_LINE,
+    /* args[0].value indexes the text of the stream, printed after ';' */
+    COMMENT,
+    /* args[0].value indexes the text of the stream, printed as is */
+    TEXT,
+    /* stands for the return sequence of a proc until it is known */
+    EPILOGUE,
+  };
+
+  Kind kind = Kind::INSTR;
+  Op8086 op = Op8086::RET;
+  Operand8086 args[2];
+};
+
+/* Assembly as a list of lines, built up by the code generator and written
+ * out once. Passes over the generated code work on lines() rather than on
+ * text. */
+class Asm8086 {
+public:
+  void instr(Op8086 op, Operand8086 a = {}, Operand8086 b = {});
+  void label(int id);
+  void src_line(int line);
+  void comment(std::string text);
+  void text(std::string text);
+  void epilogue();
+
+  std::vector<AsmLine8086> &lines() { return lines_; }
+  const std::vector<AsmLine8086> &lines() const { return lines_; }
+  const std::string &text_of(const AsmLine8086 &line) const {
+    return texts_[line.args[0].value];
+  }
+  std::string &text_of(const AsmLine8086 &line) {
+    return texts_[line.args[0].value];
+  }
+
+  /* move the lines from other to the end of this one */
+  void append(Asm8086 &&other);
+
+  /* appends the text of all lines to out */
+  void write(std::string &out) const;
+
+private:
+  void write(std::string &out, const Operand8086 &operand) const;
+
+  std::vector<AsmLine8086> lines_;
+  std::vector<std::string> texts_;
+};
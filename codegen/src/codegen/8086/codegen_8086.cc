@@ -1,72 +1,17 @@
 #include "codegen_8086.h"
+#include "codegen/proc_cache.h"
+#include "codegen/reg_alloc.h"
 #include "codegen/register.h"
+#include "compile_cache.h"
 #include "ir/ir_program.h"
+#include "thread_pool.h"
 
+#include <algorithm>
+#include <chrono>
 #include <fmt/format.h>
-
-std::string_view to_string(Op8086 op) {
-  switch (op) {
-  case Op8086::INT:
-    return "INT";
-  case Op8086::MOV:
-    return "MOV";
-  case Op8086::ADD:
-    return "ADD";
-  case Op8086::SUB:
-    return "SUB";
-  case Op8086::NEG:
-    return "NEG";
-  case Op8086::NOT:
-    return "NOT";
-  case Op8086::IMUL:
-    return "IMUL";
-  case Op8086::IDIV:
-    return "IDIV";
-  case Op8086::CWD:
-    return "CWD";
-  case Op8086::LEA:
-    return "LEA";
-  case Op8086::PUSH:
-    return "PUSH";
-  case Op8086::POP:
-    return "POP";
-  case Op8086::CALL:
-    return "CALL";
-  case Op8086::RET:
-    return "RET";
-  case Op8086::JG:
-    return "JG";
-  case Op8086::JGE:
-    return "JGE";
-  case Op8086::JL:
-    return "JL";
-  case Op8086::JLE:
-    return "JLE";
-  case Op8086::JE:
-    return "JE";
-  case Op8086::JNE:
-    return "JNE";
-  case Op8086::JMP:
-    return "JMP";
-  case Op8086::SAL:
-    return "SAL";
-  case Op8086::SAR:
-    return "SAR";
-  case Op8086::AND:
-    return "AND";
-  case Op8086::OR:
-    return "OR";
-  case Op8086::XOR:
-    return "XOR";
-  case Op8086::INC:
-    return "INC";
-  case Op8086::DEC:
-    return "DEC";
-  case Op8086::CMP:
-    return "CMP";
-  }
-  return "";
-}
+#include <optional>
+#include <sstream>
+#include <utility>
 
 Op8086 negate(Op8086 op) {
   switch (op) {
@@ -161,6 +106,21 @@ bool is_div(IROp op) {
 CodeGen8086::CodeGen8086(IRProgram *program, const char *out, bool verbose,
                          bool debug)
     : CodeGen(program, out), verbose_(verbose), debug_(debug) {
+  init_registers();
+}
+
+CodeGen8086::CodeGen8086(IRProgram *program, std::ostream &out, bool verbose,
+                         bool debug)
+    : CodeGen(program, out), verbose_(verbose), debug_(debug) {
+  init_registers();
+}
+
+CodeGen8086::CodeGen8086(IRProgram *program, bool verbose, bool debug)
+    : CodeGen(program), verbose_(verbose), debug_(debug) {
+  init_registers();
+}
+
+void CodeGen8086::init_registers() {
   using enum RegIdx8086;
   registers_.resize(REG_COUNT_8086);
   registers_[(int)AX] = std::make_unique<Register>("AX", 0.5);
@@ -174,31 +134,58 @@ CodeGen8086::CodeGen8086(IRProgram *program, const char *out, bool verbose,
   stack_start_ = 0; // backing up 3 regisers
 }
 
-void CodeGen8086::debug_print(IRAddress *addr) {
-  out_file_ << ";" << addr->name();
+Operand8086 CodeGen8086::operand(Register *reg) {
+  using enum Reg8086;
+  reg->access();
+  return reg == ax ? AX : reg == bx ? BX : reg == cx ? CX : DX;
+}
+
+void CodeGen8086::print_src_line(IRInstr *instr) {
+  if (last_src_line_ != instr->source_line()) {
+    last_src_line_ = instr->source_line();
+    asm_.src_line(last_src_line_);
+  }
+}
+
+std::string CodeGen8086::debug_print(IRAddress *addr) {
+  std::string line(addr->name());
   if (addr->is_var()) {
-    out_file_ << " (" << effective_offset(addr->var()->offset()) << ")";
+    line += " (" + offset_str(addr->var()->offset()) + ")";
   }
-  out_file_ << ": ";
+  line += ": ";
   if (!addr->is_dirty()) {
-    out_file_ << "self, ";
+    line += "self, ";
   }
   for (auto &reg : addr->registers()) {
-    out_file_ << reg->name() << ", ";
+    line += reg->name();
+    line += ", ";
   }
-  out_file_ << std::endl;
+  return line;
 }
 
 void CodeGen8086::debug_print(IRInstr *instr) {
   if (debug_) {
+    auto proc = instr->block()->proc();
+    /* in the proc's numbering rather than by pointer, so the listing
+     * doesn't depend on where things happen to be allocated */
+    auto in_order = [proc](auto &&addrs) {
+      std::vector<IRAddress *> sorted(addrs.begin(), addrs.end());
+      std::sort(sorted.begin(), sorted.end(), [proc](auto a, auto b) {
+        return proc->index(a) < proc->index(b);
+      });
+      return sorted;
+    };
     for (auto &reg : registers_) {
-      out_file_ << ";" << reg->name() << ": ";
-      for (auto &addr : reg->addresses()) {
-        out_file_ << addr->name() << ", ";
+      std::string line(reg->name());
+      line += ": ";
+      for (auto &addr : in_order(reg->addresses())) {
+        line += addr->name();
+        line += ", ";
       }
-      out_file_ << std::endl;
+      asm_.comment(std::move(line));
     }
-    std::set<IRAddress *> curr = instr->srcs();
+    auto srcs = instr->srcs();
+    std::set<IRAddress *> curr(srcs.begin(), srcs.end());
     if (auto addr = instr->dest()) {
       curr.insert(addr);
     }
@@ -207,13 +194,17 @@ void CodeGen8086::debug_print(IRInstr *instr) {
     curr.insert(last_args_.begin(), last_args_.end());
     last_args_ = std::move(t);
 
-    for (auto &addr : curr) {
-      debug_print(addr);
+    for (auto &addr : in_order(curr)) {
+      asm_.comment(debug_print(addr));
     }
-    for (auto &[_, global] : program_->globals()) {
-      debug_print(global.get());
+    for (auto &global : program_->globals()) {
+      /* the proc's copy if it references the global */
+      int i = proc->index(&global);
+      asm_.comment(debug_print(i >= 0 ? proc->address(i) : &global));
     }
-    out_file_ << ";" << *instr << std::endl;
+    std::ostringstream line;
+    line << *instr;
+    asm_.comment(std::move(line).str());
   }
 }
 
@@ -225,23 +216,22 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
   switch (instr->op()) {
   case IROp::PTRST:
   case IROp::PTRLD: {
-    std::string asm_addr;
+    Operand8086 asm_addr;
     if (instr->arg2().is_global()) {
       auto global = instr->arg2().global();
       // load index in DI
       if (instr->arg3().is_imd_int()) {
         auto off = instr->arg3().imd_int();
-        asm_addr = "WORD PTR " + std::string(global->name()) + "[" +
-                   std::to_string(off * 2) + "]";
+        asm_addr = Operand8086::mem(global->name(), Reg8086::NONE, off * 2);
       } else {
         auto addr = instr->arg3().addr();
         if (addr->is_dirty()) {
-          print_instr(Op8086::MOV, "DI", addr->get_register()->name());
+          print_instr(Op8086::MOV, Reg8086::DI, operand(addr->get_register()));
         } else {
-          print_instr(Op8086::MOV, "DI", gen_addr(addr));
+          print_instr(Op8086::MOV, Reg8086::DI, gen_addr(addr));
         }
-        print_instr(Op8086::SAL, "DI", 1);
-        asm_addr = "WORD PTR " + std::string(global->name()) + "[DI]";
+        print_instr(Op8086::SAL, Reg8086::DI, 1);
+        asm_addr = Operand8086::mem(global->name(), Reg8086::DI, 0);
       }
     } else {
       auto var = instr->arg2().var();
@@ -251,22 +241,28 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
       } else {
         auto addr = instr->arg3().addr();
         if (addr->is_dirty()) {
-          print_instr(Op8086::MOV, "SI", addr->get_register()->name());
+          print_instr(Op8086::MOV, Reg8086::SI, operand(addr->get_register()));
         } else {
-          print_instr(Op8086::MOV, "SI", gen_addr(addr));
+          print_instr(Op8086::MOV, Reg8086::SI, gen_addr(addr));
         }
         // since we are using words
-        print_instr(Op8086::SAL, "SI", 1);
+        print_instr(Op8086::SAL, Reg8086::SI, 1);
         asm_addr = gen_stack_addr(var->offset(), true);
       }
     }
     if (instr->op() == IROp::PTRLD) {
       auto addr = instr->arg1().addr();
+      if (auto home_reg = home(addr); home_reg != Reg8086::NONE) {
+        print_instr(Op8086::MOV, home_reg, asm_addr);
+        in_home(addr);
+        break;
+      }
       /* spill everything except addr in a register */
-      Register *reg = Register::min_spill_reg(registers_, instr, nullptr, addr);
+      Register *reg =
+          Register::min_spill_reg(registers_, instr, next_use_, nullptr, addr);
       spill(reg, instr, addr);
       reg->clear();
-      print_instr(Op8086::MOV, reg->name(), asm_addr);
+      print_instr(Op8086::MOV, operand(reg), asm_addr);
       /* actual value read from somewhere else in memory */
       addr->set_dirty(true);
       addr->clear_registers();
@@ -279,19 +275,22 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
         Register *reg;
         if (addr->reg_count()) {
           reg = addr->get_register();
+        } else if (home(addr) != Reg8086::NONE) {
+          print_instr(Op8086::MOV, asm_addr, home(addr));
+          break;
         } else {
           /* no register holds this addr */
           assert(!addr->is_dirty());
 
-          reg = Register::min_spill_reg(registers_, instr);
+          reg = Register::min_spill_reg(registers_, instr, next_use_);
           spill(reg, instr);
           reg->clear();
 
-          print_instr(Op8086::MOV, reg->name(), gen_addr(addr));
+          print_instr(Op8086::MOV, operand(reg), gen_addr(addr));
           addr->add_register(reg);
         }
 
-        print_instr(Op8086::MOV, asm_addr, reg->name());
+        print_instr(Op8086::MOV, asm_addr, operand(reg));
       }
     }
 
@@ -300,6 +299,18 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
     // perhaps implement constant propagation?
     auto r = instr->arg2();
     auto addr = instr->arg1().addr();
+    if (r.is_addr() && home(addr) != Reg8086::NONE) {
+      auto value = value_of(r);
+      if (!value.is_reg(home(addr))) {
+        print_instr(Op8086::MOV, home(addr), value);
+      }
+      in_home(addr);
+      /* the register it came from holds it as well */
+      if (r.addr()->reg_count()) {
+        addr->add_register(r.addr()->get_register());
+      }
+      break;
+    }
     addr->clear_registers();
 
     if (r.is_imd_int()) {
@@ -314,7 +325,7 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
         // if a register holds value exclusively update it
         addr->set_dirty(true);
         addr->add_register(reg);
-        print_instr(Op8086::MOV, reg->name(), r.imd_int());
+        print_instr(Op8086::MOV, operand(reg), r.imd_int());
       } else {
         // otherwise just write to memory
         addr->set_dirty(false);
@@ -327,10 +338,11 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
       if (raddr->reg_count()) {
         reg = raddr->get_register();
       } else {
-        reg = Register::min_spill_reg(registers_, instr, nullptr, raddr);
+        reg = Register::min_spill_reg(registers_, instr, next_use_, nullptr,
+                                      raddr);
         spill(reg, instr, raddr);
         reg->clear();
-        print_instr(Op8086::MOV, reg->name(), gen_addr(raddr));
+        print_instr(Op8086::MOV, operand(reg), gen_addr(raddr));
         raddr->add_register(reg);
       }
       /* only held by reg now */
@@ -348,6 +360,23 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
     auto arg1 = instr->arg2();
     auto arg2 = instr->arg3();
 
+    if (auto reg = home(addr); reg != Reg8086::NONE) {
+      /* straight into the home register, unless that holds the second
+       * operand and the order matters */
+      auto a = value_of(arg1), b = value_of(arg2);
+      if (b.is_reg(reg) && is_commutative(instr->op())) {
+        std::swap(a, b);
+      }
+      if (!b.is_reg(reg)) {
+        if (!a.is_reg(reg)) {
+          print_instr(Op8086::MOV, reg, a);
+        }
+        print_instr(op, reg, b);
+        in_home(addr);
+        break;
+      }
+    }
+
     if (arg1.is_imd_int()) {
       std::swap(arg1, arg2);
     }
@@ -357,11 +386,11 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
 
       auto reg = spill_and_load(raddr, instr, addr);
       reg->clear();
-      print_instr(op, reg->name(), arg2.imd_int());
+      print_instr(op, operand(reg), arg2.imd_int());
 
       if (instr->arg2().is_imd_int() && op == Op8086::SUB) {
         // only SUB is not commutative
-        print_instr(Op8086::NEG, reg->name());
+        print_instr(Op8086::NEG, operand(reg));
       }
 
       addr->set_dirty(true);
@@ -377,12 +406,12 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
         std::swap(regaddr, otheraddr);
       }
 
-      std::string otheraddrstr;
+      Operand8086 otheraddrstr;
       Register *other_reg = nullptr;
       if (otheraddr->is_dirty()) {
         assert(otheraddr->reg_count());
         other_reg = otheraddr->get_register();
-        otheraddrstr = other_reg->name();
+        otheraddrstr = operand(other_reg);
       } else {
         otheraddrstr = gen_addr(otheraddr);
       }
@@ -390,7 +419,7 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
       auto reg = spill_and_load(regaddr, instr, addr, other_reg);
       reg->clear();
 
-      print_instr(op, reg->name(), otheraddrstr);
+      print_instr(op, operand(reg), otheraddrstr);
 
       addr->set_dirty(true);
       addr->clear_registers();
@@ -405,6 +434,15 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
     // assume operand is not immediate for now
     auto raddr = instr->arg2().addr();
     auto addr = instr->arg1().addr();
+    if (auto reg = home(addr); reg != Reg8086::NONE) {
+      auto value = value_of(instr->arg2());
+      if (!value.is_reg(reg)) {
+        print_instr(Op8086::MOV, reg, value);
+      }
+      print_instr(op, reg);
+      in_home(addr);
+      break;
+    }
     // Get a register and load raddr into it
     Register *reg = spill_and_load(raddr, instr, addr);
     reg->clear();
@@ -413,7 +451,7 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
     addr->clear_registers();
     addr->add_register(reg);
 
-    print_instr(op, reg->name());
+    print_instr(op, operand(reg));
   } break;
   case IROp::LSHIFT:
   case IROp::RSHIFT: {
@@ -427,7 +465,7 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
       auto reg = spill_and_load(raddr, instr, addr);
       reg->clear();
 
-      print_instr(op, reg->name(), rarg.imd_int());
+      print_instr(op, operand(reg), rarg.imd_int());
       addr->set_dirty(true);
       addr->clear_registers();
       addr->add_register(reg);
@@ -442,13 +480,14 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
       auto saddr = rarg.addr();
       // load into register
       Register *reg =
-          Register::min_spill_reg(registers_, instr, cx, addr, raddr);
+          Register::min_spill_reg(registers_, instr, next_use_, cx, addr,
+                                  raddr);
       bool contained = raddr && reg->contains(raddr);
 
       if (reg->contains(saddr) && !cx->contains(saddr)) {
         // since reg will be spilled need to save value of saddr
         spill(cx, instr);
-        print_instr(Op8086::MOV, "CX", reg->name());
+        print_instr(Op8086::MOV, Reg8086::CX, operand(reg));
         cx->add_address(saddr);
       }
       spill(reg, instr, addr);
@@ -456,29 +495,29 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
       if (raddr) {
         if (!contained) {
           if (!raddr->is_dirty()) {
-            print_instr(Op8086::MOV, reg->name(), gen_addr(raddr));
+            print_instr(Op8086::MOV, operand(reg), gen_addr(raddr));
           } else {
-            print_instr(Op8086::MOV, reg->name(),
-                        raddr->get_register()->name());
+            print_instr(Op8086::MOV, operand(reg),
+                        operand(raddr->get_register()));
           }
         }
       } else {
-        print_instr(Op8086::MOV, reg->name(), larg.imd_int());
+        print_instr(Op8086::MOV, operand(reg), larg.imd_int());
       }
       reg->clear();
 
       spill(cx, instr, saddr);
       if (!cx->contains(saddr)) {
         if (!saddr->is_dirty()) {
-          print_instr(Op8086::MOV, "CX", gen_addr(saddr));
+          print_instr(Op8086::MOV, Reg8086::CX, gen_addr(saddr));
         } else {
-          print_instr(Op8086::MOV, "CX", saddr->get_register()->name());
+          print_instr(Op8086::MOV, Reg8086::CX, operand(saddr->get_register()));
         }
         cx->clear();
         saddr->add_register(cx);
       }
 
-      print_instr(op, reg->name(), "CL");
+      print_instr(op, operand(reg), Reg8086::CL);
       addr->set_dirty(true);
       addr->clear_registers();
       addr->add_register(reg);
@@ -504,17 +543,13 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
     }
 
     // dx must be spilled
-    spill(dx, instr, addr);
+    spill(dx, instr, addr, raddr2);
     dx->clear();
-    if (is_div(instr->op())) {
-      // zero higher order bits
-      print_instr(Op8086::CWD);
-    }
 
     // operand1 must be in AX
     if (arg1.is_imd_int()) {
       spill(ax, instr, addr, raddr2);
-      print_instr(Op8086::MOV, ax->name(), arg1.imd_int());
+      print_instr(Op8086::MOV, operand(ax), arg1.imd_int());
     } else {
       auto raddr1 = arg1.addr();
       bool contained = ax->contains(raddr1);
@@ -522,9 +557,9 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
 
       if (!contained) {
         if (!raddr1->is_dirty()) {
-          print_instr(Op8086::MOV, ax->name(), gen_addr(raddr1));
+          print_instr(Op8086::MOV, operand(ax), gen_addr(raddr1));
         } else {
-          print_instr(Op8086::MOV, ax->name(), raddr1->get_register()->name());
+          print_instr(Op8086::MOV, operand(ax), operand(raddr1->get_register()));
         }
       }
     }
@@ -534,15 +569,19 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
     Register *reg = nullptr;
     if (arg2.is_imd_int()) {
       // then just load to some register
-      reg = Register::min_spill_reg({bx, cx}, instr);
+      reg = bx_home_ ? cx : Register::min_spill_reg({bx, cx}, instr, next_use_);
       spill(reg, instr, addr);
-      print_instr(Op8086::MOV, reg->name(), arg2.imd_int());
+      print_instr(Op8086::MOV, operand(reg), arg2.imd_int());
     } else if (arg2.addr()->reg_count()) {
       reg = arg2.addr()->get_register();
     }
 
+    if (is_div(instr->op())) {
+      // sign extend AX into DX, once AX holds the dividend
+      print_instr(Op8086::CWD);
+    }
     if (reg) {
-      print_instr(op, reg->name());
+      print_instr(op, operand(reg));
     } else {
       assert(!arg2.addr()->is_dirty());
       print_instr(op, gen_addr(arg2.addr()));
@@ -565,17 +604,17 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
 
   } break;
   case IROp::JMPIF:
-    spill_all(instr);
-    print_instr(cjmp_op_, instr->arg2());
+    leave_block(instr);
+    print_instr(cjmp_op_, Operand8086::label(instr->arg2().label()->id()));
     break;
   case IROp::JMPIFNOT:
-    spill_all(instr);
+    leave_block(instr);
     cjmp_op_ = negate(cjmp_op_);
-    print_instr(cjmp_op_, instr->arg2());
+    print_instr(cjmp_op_, Operand8086::label(instr->arg2().label()->id()));
     break;
   case IROp::JMP:
-    spill_all(instr);
-    print_instr(Op8086::JMP, instr->arg1());
+    leave_block(instr);
+    print_instr(Op8086::JMP, Operand8086::label(instr->arg1().label()->id()));
     break;
   case IROp::LESS:
   case IROp::LEQ:
@@ -599,7 +638,7 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
       auto raddr = arg1.addr();
 
       if (raddr->reg_count()) {
-        print_instr(Op8086::CMP, raddr->get_register()->name(), arg2.imd_int());
+        print_instr(Op8086::CMP, operand(raddr->get_register()), arg2.imd_int());
       } else {
         print_instr(Op8086::CMP, gen_addr(raddr), arg2.imd_int());
       }
@@ -608,21 +647,24 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
       auto raddr1 = arg1.addr();
       auto raddr2 = arg2.addr();
 
-      Register *reg;
+      Operand8086 rhs;
       if (raddr2->reg_count()) {
-        reg = raddr2->get_register();
+        rhs = operand(raddr2->get_register());
+      } else if (home(raddr2) != Reg8086::NONE) {
+        rhs = home(raddr2);
       } else {
-        reg = Register::min_spill_reg(registers_, instr);
+        auto reg = Register::min_spill_reg(registers_, instr, next_use_);
         spill(reg, instr, nullptr, raddr1);
         reg->clear();
-        print_instr(Op8086::MOV, reg->name(), gen_addr(raddr2));
+        print_instr(Op8086::MOV, operand(reg), gen_addr(raddr2));
         raddr2->add_register(reg);
+        rhs = operand(reg);
       }
 
       if (raddr1->reg_count()) {
-        print_instr(Op8086::CMP, raddr1->get_register()->name(), reg->name());
+        print_instr(Op8086::CMP, operand(raddr1->get_register()), rhs);
       } else {
-        print_instr(Op8086::CMP, gen_addr(raddr1), reg->name());
+        print_instr(Op8086::CMP, gen_addr(raddr1), rhs);
       }
     }
   } break;
@@ -639,14 +681,14 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
         if (block->index() != 0) {
           // no need to do this in the very first block, since BP was just set
           // to SP
-          print_instr(Op8086::MOV, "SP", "BP");
+          print_instr(Op8086::MOV, Reg8086::SP, Reg8086::BP);
         }
-        print_instr(Op8086::ADD, "SP", effective_offset(block->stack_offset()));
+        print_instr(Op8086::ADD, Reg8086::SP, frame_offset(block->stack_offset()));
         block->set_last_stack_offset(block->stack_offset());
       } else {
         auto loff = *block->last_stack_offset();
         auto diff = block->stack_offset() - loff;
-        print_instr(Op8086::ADD, "SP", diff * 2);
+        print_instr(Op8086::ADD, Reg8086::SP, diff * 2);
         block->set_last_stack_offset(block->stack_offset());
       }
     }
@@ -658,7 +700,7 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
     auto addr = instr->arg1().addr();
     if (addr->is_dirty()) {
       assert(addr->reg_count());
-      print_instr(Op8086::PUSH, addr->get_register()->name());
+      print_instr(Op8086::PUSH, operand(addr->get_register()));
     } else {
       print_instr(Op8086::PUSH, gen_addr(addr));
     }
@@ -671,14 +713,14 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
         if (block->index() != 0) {
           // no need to do this in the very first block, since BP was just set
           // to SP
-          print_instr(Op8086::MOV, "SP", "BP");
+          print_instr(Op8086::MOV, Reg8086::SP, Reg8086::BP);
         }
-        print_instr(Op8086::ADD, "SP", effective_offset(block->stack_offset()));
+        print_instr(Op8086::ADD, Reg8086::SP, frame_offset(block->stack_offset()));
         block->set_last_stack_offset(block->stack_offset());
       } else {
         auto loff = *block->last_stack_offset();
         auto diff = block->stack_offset() - loff;
-        print_instr(Op8086::ADD, "SP", diff * 2);
+        print_instr(Op8086::ADD, Reg8086::SP, diff * 2);
         block->set_last_stack_offset(block->stack_offset());
       }
     }
@@ -687,7 +729,8 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
     spill(ax, instr);
     ax->clear();
 
-    print_instr(Op8086::CALL, instr->arg1().global()->name());
+    print_instr(Op8086::CALL,
+                Operand8086::symbol(instr->arg1().global()->name()));
     if (instr->has_arg2()) {
       /* there is return value*/
       /* return value by AX for now (for single WORD) */
@@ -707,9 +750,9 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
       spill(ax, instr);
       if (!contained) {
         if (!arg->is_dirty()) {
-          print_instr(Op8086::MOV, "AX", gen_addr(arg));
+          print_instr(Op8086::MOV, Reg8086::AX, gen_addr(arg));
         } else {
-          print_instr(Op8086::MOV, "AX", arg->get_register()->name());
+          print_instr(Op8086::MOV, Reg8086::AX, operand(arg->get_register()));
         }
       }
     }
@@ -721,9 +764,15 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
   case IROp::ENDP:
   case IROp::PROC:
   case IROp::LABEL:
+  case IROp::PALLOC:
+    if (auto reg = home(instr->arg1().addr()); reg != Reg8086::NONE) {
+      /* parameters are passed on the stack */
+      print_instr(Op8086::MOV, reg,
+                  gen_stack_addr(instr->arg1().var()->offset()));
+    }
+    break;
   case IROp::ALLOC:
   case IROp::AALLOC:
-  case IROp::PALLOC:
   case IROp::GLOBAL:
   case IROp::GLOBALARR:
     break;
@@ -734,103 +783,408 @@ void CodeGen8086::gen_instr(IRInstr *instr) {
 
 void CodeGen8086::gen_block(IRBlock *block) {
   if (block->label()) {
-    print_label(block->label()->name());
+    print_label(block->label());
   }
   if (block->size()) {
-    for (auto &reg : registers_) {
-      reg->clear();
-    }
+    enter_block(block);
 
+    next_use_.start_block(block);
     for (auto &instr : block->instrs()) {
+      next_use_.advance(&instr);
       gen_instr(&instr);
     }
 
     // need to spill if instr wasn't jump
     if (!block->instrs().back().is_jump()) {
-      spill_all(&block->instrs().back());
+      leave_block(&block->instrs().back());
     }
   }
 }
 
+/* A block entered only from the block before it in the flow graph starts
+ * out with the registers as that one left them, values not yet stored
+ * included. Where control flow merges, the registers keep what every
+ * predecessor left in them, which is only known for predecessors that
+ * were generated already, and they all stored their values. */
+void CodeGen8086::enter_block(IRBlock *block) {
+  for (auto &reg : registers_) {
+    reg->clear();
+  }
+  auto &preds = block->predecessors();
+  if (preds.empty()) {
+    return;
+  }
+  std::vector<Binding> *first = nullptr;
+  for (auto pred : preds) {
+    auto itr = exits_.find(pred);
+    if (itr == exits_.end()) {
+      return;
+    }
+    first = first ? first : &itr->second;
+  }
+  for (auto [reg, addr, dirty] : *first) {
+    bool everywhere = std::all_of(preds.begin(), preds.end(), [&](auto pred) {
+      auto &exit = exits_[pred];
+      return std::any_of(exit.begin(), exit.end(), [&](auto &binding) {
+        return binding.reg == reg && binding.addr == addr;
+      });
+    });
+    if (everywhere) {
+      reg->add_address(addr);
+      addr->set_dirty(dirty);
+    }
+  }
+}
+
+void CodeGen8086::leave_block(IRInstr *instr) {
+  auto block = instr->block();
+  auto &succs = block->successors();
+  bool carry = std::all_of(succs.begin(), succs.end(), [block](auto succ) {
+    auto &preds = succ->predecessors();
+    return std::all_of(preds.begin(), preds.end(),
+                       [block](auto pred) { return pred == block; });
+  });
+
+  auto &exit = exits_[block];
+  exit.clear();
+  for (auto &reg : registers_) {
+    for (auto addr : reg->addresses()) {
+      bool live = addr->is_var() &&
+                  block->live_on_exit().contains(proc_->index(addr));
+      if (addr->is_dirty() && !(carry && live) &&
+          (next_use_.used_again(instr, addr) || addr->is_global())) {
+        /* where blocks merge, values are in memory */
+        store(reg.get(), addr);
+      }
+      if (live) {
+        exit.push_back({reg.get(), addr, addr->is_dirty()});
+      }
+    }
+  }
+  for (auto &reg : registers_) {
+    for (auto addr : reg->addresses()) {
+      /* dead, whatever was in the register doesn't matter any more */
+      addr->set_dirty(false);
+    }
+    reg->clear();
+  }
+}
+
 void CodeGen8086::gen_proc(IRProc *proc) {
-  out_file_ << proc->name() << " PROC" << std::endl;
+  size_t start = asm_.lines().size();
+  asm_.text(std::string(proc->name()) + " PROC");
   stack_start_ = 0;
+  /* nothing carries over from the previous proc, so procs can be
+   * generated in any order */
+  last_src_line_ = 0;
+  last_args_.clear();
+  stack_accessed_ = false;
+  reset_registers();
+  reset_globals(proc);
+  alloc_homes(proc);
+  exits_.clear();
   if (proc->name() == "main") {
-    print_instr(Op8086::MOV, "AX", "@DATA");
-    print_instr(Op8086::MOV, "DS", "AX");
-    print_instr(Op8086::MOV, "BP", "SP");
+    print_instr(Op8086::MOV, Reg8086::AX, Operand8086::symbol("@DATA"));
+    print_instr(Op8086::MOV, Reg8086::DS, Reg8086::AX);
+    print_instr(Op8086::MOV, Reg8086::BP, Reg8086::SP);
+    for (auto &block : proc->blocks()) {
+      gen_block(block.get());
+    }
   } else {
-    // dry run to find which registers are used
-    // and if the stack is ever used
-    dry_run_ = true;
-    stack_accessed_ = false;
-    reset_registers();
-    reset_globals();
+    /* Which registers to save, and whether BP is needed, is only known
+     * once the body is generated. So the body is generated first, with
+     * the epilogue and the offsets of parameters (which sit above the
+     * saved registers) left open, and filled in after the prologue. */
+    prime_stack_offsets(proc);
+    auto head = std::exchange(asm_, {});
+    deferred_ = true;
     for (auto &block : proc->blocks()) {
       gen_block(block.get());
     }
-    dry_run_ = false;
+    deferred_ = false;
+    auto body = std::exchange(asm_, std::move(head));
+
     // save BP only if the stack is used
     if (stack_accessed_) {
-      print_instr(Op8086::PUSH, "BP");
+      print_instr(Op8086::PUSH, Reg8086::BP);
     }
     // push the registers that were accessed
+    saved_.clear();
     for (auto &reg : registers_) {
-      if (reg->accessed() && reg->name() != "AX") {
-        print_instr(Op8086::PUSH, reg->name());
-        stack_start_ += 2;
+      if (reg->accessed() && reg.get() != ax) {
+        saved_.push_back(operand(reg.get()).reg);
+      }
+    }
+    // and the homes, SI and DI are scratch otherwise
+    for (auto reg : {Reg8086::BX, Reg8086::SI, Reg8086::DI}) {
+      if (std::find(home_.begin(), home_.end(), reg) != home_.end() &&
+          std::find(saved_.begin(), saved_.end(), reg) == saved_.end()) {
+        saved_.push_back(reg);
       }
     }
+    for (auto reg : saved_) {
+      print_instr(Op8086::PUSH, reg);
+      stack_start_ += 2;
+    }
     // update BP only if the stack was ever used
     if (stack_accessed_) {
-      print_instr(Op8086::MOV, "BP", "SP");
+      print_instr(Op8086::MOV, Reg8086::BP, Reg8086::SP);
     }
+    fill_in(std::move(body), proc);
+  }
+
+  asm_.text(std::string(proc->name()) + " ENDP");
+  count(start);
+}
+
+void CodeGen8086::alloc_homes(IRProc *proc) {
+  proc_ = proc;
+  home_.clear();
+  if (bx_home_) {
+    registers_.insert(registers_.begin() + (int)RegIdx8086::BX,
+                      std::move(bx_home_));
+  }
+  if (!reg_alloc_) {
+    return;
   }
 
-  reset_registers(false);
-  reset_globals();
+  /* vars that can't live in a register: arrays, and the results of
+   * comparisons, which are flags until a jump uses them; SI and DI hold
+   * array indices wherever they aren't constant */
+  BitSet candidates(proc->num_addresses());
+  BitSet excluded(proc->num_addresses());
+  bool si = true, di = true;
+  int rets = 0;
   for (auto &block : proc->blocks()) {
-    gen_block(block.get());
+    for (auto &instr : block->instrs()) {
+      switch (instr.op()) {
+      case IROp::RET:
+        rets++;
+        break;
+      case IROp::PTRLD:
+      case IROp::PTRST:
+        if (instr.arg2().is_var()) {
+          excluded.insert(proc->index(instr.arg2().addr()));
+        }
+        if (!instr.arg3().is_imd_int()) {
+          (instr.arg2().is_global() ? di : si) = false;
+        }
+        break;
+      case IROp::AALLOC:
+      case IROp::ADDR:
+      case IROp::LESS:
+      case IROp::LEQ:
+      case IROp::GREAT:
+      case IROp::GEQ:
+      case IROp::EQ:
+      case IROp::NEQ:
+        excluded.insert(proc->index(instr.arg1().addr()));
+        break;
+      default:
+        break;
+      }
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (addr && addr->is_var() && addr->var()->size() == 1) {
+          candidates.insert(proc->index(addr));
+        }
+      }
+    }
+  }
+  excluded.for_each([&](size_t i) { candidates.erase(i); });
+
+  std::vector<Reg8086> colors{Reg8086::BX};
+  if (si) {
+    colors.push_back(Reg8086::SI);
+  }
+  if (di) {
+    colors.push_back(Reg8086::DI);
+  }
+  /* a var used only where it is defined and once after is as well off in
+   * the registers of a block */
+  RegAlloc alloc(proc, candidates, colors.size(), 3);
+
+  /* other than main, a proc saves what it uses and restores it at every
+   * return, which is only worth it for enough references */
+  std::vector<float> weight(colors.size());
+  candidates.for_each([&](size_t i) {
+    if (int color = alloc.color(i); color >= 0) {
+      weight[color] += alloc.weight(i);
+    }
+  });
+  std::vector<float> cost(colors.size());
+  if (proc->name() != "main") {
+    for (auto &c : cost) {
+      c = 1 + rets;
+    }
+    /* and BX out of the pool most likely means saving CX instead */
+    cost[0] *= 2;
+  }
+  home_.assign(proc->num_addresses(), Reg8086::NONE);
+  bool bx_used = false;
+  candidates.for_each([&](size_t i) {
+    if (int color = alloc.color(i); color >= 0 && weight[color] > cost[color]) {
+      home_[i] = colors[color];
+      bx_used |= color == 0;
+      homed_++;
+    }
+  });
+  if (bx_used) {
+    /* out of the pool for this proc */
+    bx_home_ = std::move(registers_[(int)RegIdx8086::BX]);
+    registers_.erase(registers_.begin() + (int)RegIdx8086::BX);
+  }
+}
+
+Operand8086 CodeGen8086::value_of(IRArg arg) {
+  if (arg.is_imd_int()) {
+    return arg.imd_int();
+  }
+  return value_of(arg.addr());
+}
+
+Operand8086 CodeGen8086::value_of(IRAddress *addr) {
+  if (addr->reg_count()) {
+    return operand(addr->get_register());
+  }
+  return gen_addr(addr);
+}
+
+void CodeGen8086::count(size_t from) {
+  auto &lines = asm_.lines();
+  for (size_t i = from; i < lines.size(); i++) {
+    auto &line = lines[i];
+    if (line.kind != AsmLine8086::Kind::INSTR) {
+      continue;
+    }
+    instr_count_++;
+    auto &[a, b] = line.args;
+    auto in_frame = [](const Operand8086 &arg) {
+      return arg.kind == Operand8086::Kind::MEM && arg.reg == Reg8086::BP &&
+             arg.index == Reg8086::NONE;
+    };
+    if (line.op == Op8086::MOV &&
+        ((a.kind == Operand8086::Kind::REG && in_frame(b)) ||
+         (in_frame(a) && b.kind == Operand8086::Kind::REG))) {
+      stack_moves_++;
+    }
+  }
+}
+
+void CodeGen8086::print_stats(FILE *out) {
+  fmt::print(out, "{:<20} {:>8}\n", "instructions", instr_count_);
+  fmt::print(out, "{:<20} {:>8}\n", "stack moves", stack_moves_);
+  fmt::print(out, "{:<20} {:>8}\n", "vars in registers", homed_);
+  fmt::print(out, "{:<20} {:>8}\n", "gen time (us)", gen_micros_);
+  if (cached_) {
+    /* neither analysed nor generated, so missing from all of the above */
+    fmt::print(out, "{:<20} {:>8}  (not counted above)\n", "procs from cache",
+               cached_);
   }
+}
+
+void CodeGen8086::fill_in(Asm8086 &&body, IRProc *proc) {
+  auto epilogue = std::exchange(asm_, {});
+  proc_ret(proc);
+  std::swap(epilogue, asm_);
+
+  std::vector<AsmLine8086> lines;
+  lines.reserve(body.lines().size());
+  for (auto &line : body.lines()) {
+    switch (line.kind) {
+    case AsmLine8086::Kind::EPILOGUE:
+      lines.insert(lines.end(), epilogue.lines().begin(),
+                   epilogue.lines().end());
+      continue;
+    case AsmLine8086::Kind::COMMENT:
+      /* the debug listing */
+      for (auto &text = body.text_of(line);;) {
+        auto mark = text.find(PARAM_MARK);
+        if (mark == std::string::npos) {
+          break;
+        }
+        auto end = text.find(PARAM_MARK, mark + 1);
+        int offset = -std::stoi(text.substr(mark + 1, end - mark - 1));
+        text.replace(mark, end - mark + 1,
+                     std::to_string(effective_offset(offset)));
+      }
+      break;
+    default:
+      for (auto &arg : line.args) {
+        if (arg.frame) {
+          arg.value = effective_offset(arg.value);
+          arg.frame = false;
+        }
+      }
+      break;
+    }
+    lines.push_back(line);
+  }
+  body.lines() = std::move(lines);
+  asm_.append(std::move(body));
+}
 
-  out_file_ << proc->name() << " ENDP" << std::endl;
+/* The frame adjustment before a block's first call is made relative to
+ * where SP was left by the block's last call. That is how the output came
+ * out when procs other than main were generated twice and the first pass
+ * left this behind, and the output is kept as it was. */
+void CodeGen8086::prime_stack_offsets(IRProc *proc) {
+  bool call_seq = false;
+  for (auto &block : proc->blocks()) {
+    for (auto &instr : block->instrs()) {
+      if (instr.op() == IROp::PARAM) {
+        if (!call_seq) {
+          call_seq = true;
+          block->set_last_stack_offset(block->stack_offset());
+        }
+        block->set_last_stack_offset(*block->last_stack_offset() + 1);
+      } else if (instr.op() == IROp::CALL) {
+        if (!call_seq) {
+          block->set_last_stack_offset(block->stack_offset());
+        }
+        call_seq = false;
+      }
+    }
+  }
 }
 
-std::string CodeGen8086::gen_addr(IRAddress *addr) {
+Operand8086 CodeGen8086::gen_addr(IRAddress *addr) {
+  if (auto reg = home(addr); reg != Reg8086::NONE) {
+    return reg;
+  }
   if (addr->is_global()) {
-    return std::string(addr->global()->name());
+    return Operand8086::symbol(addr->global()->name());
   } else {
     auto var = addr->var();
     return gen_stack_addr(var->offset());
   }
 }
 
-std::string CodeGen8086::gen_stack_addr(int off, bool with_si) {
+Operand8086 CodeGen8086::gen_stack_addr(int off, bool with_si) {
   stack_accessed_ = true;
-  int offset = effective_offset(off);
-  std::string offstr = (offset > 0 ? "+" : "") + std::to_string(offset);
-  if (with_si) {
-    return "WORD PTR [BP+SI" + offstr + "]";
-  } else {
-    return "WORD PTR [BP" + offstr + "]";
-  }
+  auto disp = frame_offset(off);
+  auto addr = Operand8086::mem(Reg8086::BP,
+                               with_si ? Reg8086::SI : Reg8086::NONE,
+                               disp.value);
+  addr.frame = disp.frame;
+  return addr;
 }
 
 void CodeGen8086::store(Register *reg, IRAddress *addr) {
   addr->set_dirty(false);
-  print_instr(Op8086::MOV, gen_addr(addr), reg->name());
+  print_instr(Op8086::MOV, gen_addr(addr), operand(reg));
 }
 
 void CodeGen8086::load(Register *reg, IRAddress *addr) {
-  print_instr(Op8086::MOV, reg->name(), gen_addr(addr));
+  print_instr(Op8086::MOV, operand(reg), gen_addr(addr));
 }
 
 void CodeGen8086::store(Register *reg, int offset) {
-  print_instr(Op8086::MOV, gen_stack_addr(offset), reg->name());
+  print_instr(Op8086::MOV, gen_stack_addr(offset), operand(reg));
 }
 
 void CodeGen8086::load(Register *reg, int offset) {
-  print_instr(Op8086::MOV, reg->name(), gen_stack_addr(offset));
+  print_instr(Op8086::MOV, operand(reg), gen_stack_addr(offset));
 }
 
 void CodeGen8086::spill(Register *reg, IRInstr *instr, IRAddress *except,
@@ -838,7 +1192,7 @@ void CodeGen8086::spill(Register *reg, IRInstr *instr, IRAddress *except,
   if (preserve && preserve != except) {
     if (reg->contains(preserve)) {
       if (preserve->held_only_at(reg)) {
-        if (!instr->next_use().contains(preserve)) {
+        if (!next_use_.used_again(instr, preserve)) {
           store(reg, preserve);
         }
       }
@@ -847,7 +1201,7 @@ void CodeGen8086::spill(Register *reg, IRInstr *instr, IRAddress *except,
   for (auto &addr : reg->addresses()) {
     if (addr != except) {
       // globals always need to be spilled
-      if (instr->next_use().contains(addr) || addr->is_global()) {
+      if (next_use_.used_again(instr, addr) || addr->is_global()) {
         /* no use saving information which is never used again */
         if (addr->is_dirty() && addr->reg_count() == 1) {
           /* only store value if value is not up to date  and not saved
@@ -872,7 +1226,7 @@ void CodeGen8086::spill(Register *reg, IRInstr *instr,
                         std::set<IRAddress *> except) {
   for (auto &addr : reg->addresses()) {
     if (!except.contains(addr)) {
-      if (instr->next_use().contains(addr) || addr->is_global()) {
+      if (next_use_.used_again(instr, addr) || addr->is_global()) {
         /* no use saving information which is never used again */
         if (addr->is_dirty() && addr->reg_count() == 1) {
           /* only store value if value is not up to date  and not saved
@@ -885,6 +1239,24 @@ void CodeGen8086::spill(Register *reg, IRInstr *instr,
   }
 }
 
+Operand8086 CodeGen8086::frame_offset(int offset) {
+  if (deferred_ && offset <= 0) {
+    /* filled in by fill_in */
+    Operand8086 imm(offset);
+    imm.frame = true;
+    return imm;
+  }
+  return effective_offset(offset);
+}
+
+std::string CodeGen8086::offset_str(int offset) {
+  if (deferred_ && offset <= 0) {
+    /* filled in by fill_in */
+    return PARAM_MARK + std::to_string(-offset) + PARAM_MARK;
+  }
+  return std::to_string(effective_offset(offset));
+}
+
 int CodeGen8086::effective_offset(int offset) {
   if (offset > 0) {
     return -2 * offset;
@@ -896,32 +1268,37 @@ int CodeGen8086::effective_offset(int offset) {
 Register *CodeGen8086::spill_and_load(IRAddress *addr, IRInstr *instr,
                                       IRAddress *spill_except, Register *skip) {
   Register *reg =
-      Register::min_spill_reg(registers_, instr, skip, spill_except, addr);
-  if (!reg->contains(addr)) {
-    print_instr(Op8086::MOV, reg->name(), gen_addr(addr));
+      Register::min_spill_reg(registers_, instr, next_use_, skip,
+                              spill_except, addr);
+  if (reg->contains(addr)) {
+    spill(reg, instr, spill_except);
+  } else {
+    /* what reg held is stored before it is overwritten, and the value
+     * might only be in another register */
+    spill(reg, instr, spill_except);
+    print_instr(Op8086::MOV, operand(reg), value_of(addr));
   }
-  spill(reg, instr, spill_except);
   return reg;
 }
 
 void CodeGen8086::proc_ret(IRProc *proc) {
-  if (proc->name() != "main") {
+  if (deferred_) {
+    /* registers to restore aren't known yet, filled in by fill_in */
+    asm_.epilogue();
+  } else if (proc->name() != "main") {
     if (stack_accessed_) {
-      print_instr(Op8086::MOV, "SP", "BP");
+      print_instr(Op8086::MOV, Reg8086::SP, Reg8086::BP);
     }
-    for (int i = registers_.size() - 1; i >= 0; i--) {
-      auto reg = registers_[i].get();
-      if (reg->accessed() && reg->name() != "AX") {
-        print_instr(Op8086::POP, reg->name());
-      }
+    for (auto itr = saved_.rbegin(); itr != saved_.rend(); ++itr) {
+      print_instr(Op8086::POP, *itr);
     }
     if (stack_accessed_) {
-      print_instr(Op8086::POP, "BP");
+      print_instr(Op8086::POP, Reg8086::BP);
     }
     print_instr(Op8086::RET);
   } else {
-    print_instr(Op8086::MOV, "AH", "4CH");
-    print_instr(Op8086::INT, "21H");
+    print_instr(Op8086::MOV, Reg8086::AH, Operand8086::symbol("4CH"));
+    print_instr(Op8086::INT, Operand8086::symbol("21H"));
   }
 }
 
@@ -933,8 +1310,7 @@ void CodeGen8086::spill_all(IRInstr *instr) {
 }
 
 void CodeGen8086::gen_global(IRGlobal *global) {
-  out_file_ << global->name() << " DW " << global->size() << " DUP (0000H)"
-            << std::endl;
+  asm_.text(fmt::format("{} DW {} DUP (0000H)", global->name(), global->size()));
 }
 
 constexpr const char *built_in = R"(println PROC             
@@ -982,22 +1358,77 @@ LOOP_PRINT:
     RET
 println ENDP)";
 
-void CodeGen8086::gen() {
-  out_file_ << ".MODEL SMALL" << std::endl << ".STACK 1000H" << std::endl;
+void CodeGen8086::gen(int jobs) {
+  asm_.text(".MODEL SMALL");
+  asm_.text(".STACK 1000H");
   if (!program_->globals().empty()) {
-    out_file_ << ".DATA" << std::endl;
-    for (auto &[_, global] : program_->globals()) {
-      if (global->size()) {
-        gen_global(global.get());
+    asm_.text(".DATA");
+    for (auto &global : program_->globals()) {
+      if (global.size()) {
+        gen_global(&global);
       }
     }
   }
-  out_file_ << ".CODE" << std::endl;
-  for (auto &proc : program_->procs()) {
-    gen_proc(proc.get());
+  asm_.text(".CODE");
+  /* what a proc's text depends on besides the proc */
+  std::string salt =
+      fmt::format("{} {} {} {} {} {}", verbose_, debug_, reg_alloc_,
+                  passes_.ssa, passes_.sccp, passes_.dce);
+  if (debug_) {
+    /* the listing shows every global */
+    for (auto &global : program_->globals()) {
+      salt += fmt::format(" {}", global.name());
+    }
+  }
+  /* every proc gets a generator and text of its own */
+  auto &procs = program_->procs();
+  std::vector<std::string> text(procs.size());
+  std::vector<std::array<size_t, 4>> counts(procs.size());
+  std::vector<char> cached(procs.size());
+  ThreadPool pool(jobs);
+  pool.run(procs.size(), [&](size_t i) {
+    std::optional<ProcCacheEntry> entry;
+    if (cache_) {
+      entry.emplace(procs[i].get(), salt, verbose_);
+      if (auto hit = cache_->load(CompileCache::Kind::PROC, entry->key())) {
+        text[i] = entry->relocate(*hit);
+        cached[i] = true;
+        return;
+      }
+    }
+    CodeGen8086 codegen(program_, verbose_, debug_);
+    codegen.set_reg_alloc(reg_alloc_);
+    procs[i]->process(passes_);
+    /* code generation on its own, the analyses aside */
+    auto start = std::chrono::steady_clock::now();
+    codegen.gen_proc(procs[i].get());
+    size_t micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    codegen.asm_.write(text[i]);
+    counts[i] = {codegen.instr_count_, codegen.stack_moves_, codegen.homed_,
+                 micros};
+    if (entry) {
+      cache_->store(entry->key(), entry->canonical(text[i]));
+    }
+  });
+  for (auto [instrs, stack_moves, homed, micros] : counts) {
+    instr_count_ += instrs;
+    stack_moves_ += stack_moves;
+    homed_ += homed;
+    gen_micros_ += micros;
+  }
+  cached_ += std::count(cached.begin(), cached.end(), true);
+  /* all of it goes out in one write */
+  std::string out;
+  asm_.write(out);
+  for (auto &proc_text : text) {
+    out += proc_text;
   }
-  out_file_ << built_in << std::endl;
-  out_file_ << "END main" << std::endl;
+  out += built_in;
+  out += "\nEND main\n";
+  out_->write(out.data(), out.size());
+  out_->flush();
 }
 
 void CodeGen8086::reset_registers(bool clear_access) {
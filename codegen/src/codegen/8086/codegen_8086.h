@@ -1,46 +1,18 @@
 #pragma once
 
+#include "codegen/8086/asm_8086.h"
 #include "codegen/codegen.h"
 #include "codegen/register.h"
 #include <array>
 #include <fstream>
+#include <string_view>
+#include <unordered_map>
 
-enum class Op8086 {
-  INT,
-  MOV,
-  ADD,
-  SUB,
-  NEG,
-  AND,
-  OR,
-  XOR,
-  CWD,
-  INC,
-  DEC,
-  NOT,
-  CMP,
-  IMUL,
-  IDIV,
-  SAL,
-  SAR,
-  LEA,
-  PUSH,
-  POP,
-  CALL,
-  RET,
-  JG,
-  JGE,
-  JL,
-  JLE,
-  JE,
-  JNE,
-  JMP
-};
+class CompileCache;
 
 enum class RegIdx8086 { AX, BX, CX, DX };
 constexpr int REG_COUNT_8086 = 4;
 
-std::string_view to_string(Op8086 op);
 Op8086 map_opcode(IROp op);
 Op8086 negate(Op8086 op);
 bool is_div(IROp op);
@@ -50,6 +22,8 @@ class CodeGen8086 : public CodeGen {
 public:
   CodeGen8086(IRProgram *program, const char *out, bool verbose = false,
               bool debug = false);
+  CodeGen8086(IRProgram *program, std::ostream &out, bool verbose = false,
+              bool debug = false);
 
   void gen_proc(IRProc *proc) override;
   void gen_block(IRBlock *block) override;
@@ -59,8 +33,8 @@ public:
   // function return sequence
   void proc_ret(IRProc *proc);
 
-  std::string gen_addr(IRAddress *addr);
-  std::string gen_stack_addr(int offset, bool with_si = false);
+  Operand8086 gen_addr(IRAddress *addr);
+  Operand8086 gen_stack_addr(int offset, bool with_si = false);
 
   void store(Register *reg, int offset);
   void load(Register *reg, int offset);
@@ -68,6 +42,11 @@ public:
   void load(Register *reg, IRAddress *addr);
 
   int effective_offset(int offset);
+  /* effective_offset, or the offset itself marked as such while it isn't
+   * known */
+  Operand8086 frame_offset(int offset);
+  /* the same for the debug listing, which is text */
+  std::string offset_str(int offset);
 
   /*** the third parameter is the trickiest ***/
   /* in a very special case, it can be that we need an address for an operation
@@ -80,21 +59,110 @@ public:
              IRAddress *preserve = nullptr);
   void spill(Register *reg, IRInstr *instr, std::set<IRAddress *> except);
   void spill_all(IRInstr *instr);
-
-  void gen();
+  /* sets up the registers at the start of block, see enter_block */
+  void enter_block(IRBlock *block);
+  /* stores what has to be stored at the end of the block of instr, and
+   * keeps what the registers hold for its successors */
+  void leave_block(IRInstr *instr);
+
+  /* Procs are processed and generated on jobs threads, each into a buffer
+   * of its own, and written out in order. The output doesn't depend on
+   * jobs. */
+  void gen(int jobs = 1);
+
+  /* reuse the text of procs compiled before, and keep the text of new
+   * ones, see ProcCacheEntry. Procs found are not processed. */
+  void set_cache(CompileCache *cache) { cache_ = cache; }
+
+  /* keep vars in BX, SI and DI across blocks, see RegAlloc */
+  void set_reg_alloc(bool reg_alloc) { reg_alloc_ = reg_alloc; }
+  /* optional passes each proc gets before it is generated */
+  void set_passes(IRPasses passes) { passes_ = passes; }
+
+  /* instructions generated, and moves between a register and a stack
+   * slot among them, over the procs generated so far, and the time
+   * generating them took without the analyses; procs taken from the cache
+   * are only counted as such */
+  void print_stats(FILE *out);
 
 private:
+  CodeGen8086(IRProgram *program, bool verbose, bool debug);
+
+  void print_instr(Op8086 op, Operand8086 a = {}, Operand8086 b = {}) {
+    asm_.instr(op, a, b);
+  }
+  void print_label(IRLabel *label) { asm_.label(label->id()); }
+  void print_src_line(IRInstr *instr);
+  /* reg as an operand; marks it accessed */
+  Operand8086 operand(Register *reg);
+
+  void init_registers();
   void reset_registers(bool clear_access = true);
-  void debug_print(IRAddress *addr);
+  std::string debug_print(IRAddress *addr);
   void debug_print(IRInstr *instr);
   // loads addr into register (doesn't clear reg)
   Register *spill_and_load(IRAddress *addr, IRInstr *instr,
                            IRAddress *spill_except, Register *skip = nullptr);
 
+  /* picks the register each var lives in for the whole proc, if any */
+  void alloc_homes(IRProc *proc);
+  /* the register addr lives in, NONE if it lives in memory */
+  Reg8086 home(IRAddress *addr) {
+    if (home_.empty() || !addr->is_var()) {
+      return Reg8086::NONE;
+    }
+    int i = proc_->index(addr);
+    return i < 0 ? Reg8086::NONE : home_[i];
+  }
+  /* where the current value of arg is */
+  Operand8086 value_of(IRArg arg);
+  Operand8086 value_of(IRAddress *addr);
+  /* addr was just written to its home register */
+  void in_home(IRAddress *addr) {
+    addr->clear_registers();
+    addr->set_dirty(false);
+  }
+  /* adds the lines of asm_ from from on to the stats */
+  void count(size_t from);
+
+  /* the body of a proc is generated before its prologue, see gen_proc */
+  void prime_stack_offsets(IRProc *proc);
+  void fill_in(Asm8086 &&body, IRProc *proc);
+  /* where a parameter offset goes in the debug listing */
+  static constexpr char PARAM_MARK = '\x01';
+  bool deferred_ = false;
+
+  /* what the current proc, or the program, has generated so far */
+  Asm8086 asm_;
+
   bool call_seq_ = false;
   std::vector<std::unique_ptr<Register>> registers_;
   Register *ax, *bx, *cx, *dx;
 
+  bool reg_alloc_ = false;
+  IRPasses passes_;
+  IRProc *proc_ = nullptr;
+  /* by IRProc::index */
+  std::vector<Reg8086> home_;
+  /* BX while it is a home and out of registers_ */
+  std::unique_ptr<Register> bx_home_;
+  /* pushed by the prologue, in order */
+  std::vector<Reg8086> saved_;
+
+  /* what a register holds at the end of a block */
+  struct Binding {
+    Register *reg;
+    IRAddress *addr;
+    bool dirty;
+  };
+  std::unordered_map<IRBlock *, std::vector<Binding>> exits_;
+
+  size_t instr_count_ = 0;
+  size_t stack_moves_ = 0;
+  size_t homed_ = 0;
+  size_t cached_ = 0;
+  size_t gen_micros_ = 0;
+
   Op8086 cjmp_op_;
 
   int stack_start_;
@@ -102,4 +170,5 @@ private:
   std::set<IRAddress *> last_args_;
   bool verbose_ = false;
   bool debug_ = false;
+  CompileCache *cache_ = nullptr;
 };
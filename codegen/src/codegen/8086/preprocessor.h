@@ -1,4 +1,8 @@
-
 #pragma once
 
-void preprocess(const char *in, const char *out);
+#include <string_view>
+
+/* prototypes of the runtime routines the 8086 backend provides, scanned
+ * ahead of every source file; no trailing newline, so line numbers of the
+ * source are unaffected */
+constexpr std::string_view built_in_headers = R"(void println(int);)";
@@ -2,25 +2,15 @@
 #include "ir/ir_address.h"
 
 CodeGen::CodeGen(IRProgram *program, const char *out)
-    : program_(program), out_file_(out) {}
+    : program_(program), file_(out), out_(&file_) {}
 
-void CodeGen::print_label(std::string_view label) {
-  if (!dry_run_) {
-    out_file_ << label << ": " << std::endl;
-  }
-}
+CodeGen::CodeGen(IRProgram *program, std::ostream &out)
+    : program_(program), out_(&out) {}
 
-void CodeGen::print_src_line(IRInstr *instr) {
-  if (!dry_run_) {
-    if (last_src_line_ != instr->source_line()) {
-      last_src_line_ = instr->source_line();
-      out_file_ << "; line #" << last_src_line_ << std::endl;
-    }
-  }
-}
+CodeGen::CodeGen(IRProgram *program) : program_(program) {}
 
-void CodeGen::reset_globals() {
-  for (auto &[_, var] : program_->globals()) {
-    var->reset();
+void CodeGen::reset_globals(IRProc *proc) {
+  for (auto &global : proc->globals()) {
+    global.reset();
   }
 }
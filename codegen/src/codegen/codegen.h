@@ -4,12 +4,15 @@
 #include "ir/ir_instr.h"
 #include "ir/ir_proc.h"
 #include "ir/ir_program.h"
+#include "ir/next_use.h"
 
 #include <fstream>
+#include <ostream>
 
 class CodeGen {
 public:
   CodeGen(IRProgram *program, const char *out);
+  CodeGen(IRProgram *program, std::ostream &out);
   virtual void gen_proc(IRProc *proc) = 0;
   virtual void gen_block(IRBlock *block) = 0;
   virtual void gen_instr(IRInstr *instr) = 0;
@@ -17,41 +20,20 @@ public:
   virtual ~CodeGen() = default;
 
 protected:
-  void reset_globals();
-  void print_instr(auto op);
-  void print_instr(auto op, auto &&a1);
-  void print_instr(auto op, auto &&a1, auto &&a2);
-  void print_instr(auto op, auto &&a1, auto &&a2, auto &&a3);
-  void print_label(std::string_view label);
-  void print_src_line(IRInstr *instr);
+  /* for a generator whose output the caller takes directly */
+  explicit CodeGen(IRProgram *program);
+
+  void reset_globals(IRProc *proc);
 
   IRProgram *program_;
-  std::ofstream out_file_;
+  /* only open when generating into a file of our own */
+  std::ofstream file_;
+  /* the file or the caller's stream, written once when all is generated */
+  std::ostream *out_ = nullptr;
+
+  /* positioned at the instruction being generated */
+  NextUse next_use_;
 
-  bool dry_run_ = false;
   bool stack_accessed_ = false;
   int last_src_line_ = 0;
 };
-
-void CodeGen::print_instr(auto op) {
-  if (!dry_run_) {
-    out_file_ << "\t" << to_string(op) << std::endl;
-  }
-}
-
-void CodeGen::print_instr(auto op, auto &&a1) {
-  if (!dry_run_) {
-    out_file_ << "\t" << to_string(op) << " " << a1 << std::endl;
-  }
-}
-void CodeGen::print_instr(auto op, auto &&a1, auto &&a2) {
-  if (!dry_run_) {
-    out_file_ << "\t" << to_string(op) << " " << a1 << ", " << a2 << std::endl;
-  }
-}
-void CodeGen::print_instr(auto op, auto &&a1, auto &&a2, auto &&a3) {
-  if (!dry_run_) {
-    out_file_ << "\t" << to_string(op) << " " << a1 << ", " << a2 << ", " << a3
-              << std::endl;
-  }
-}
@@ -0,0 +1,158 @@
+#include "proc_cache.h"
+#include "compile_cache.h"
+
+#include <bit>
+#include <cctype>
+#include <charconv>
+
+static constexpr std::string_view LINE_PREFIX = "; line #";
+
+static bool is_ident(char c) {
+  return std::isalnum((unsigned char)c) || c == '_' || c == '@';
+}
+
+/* number at the start of text, and how many characters it took */
+static std::pair<int, size_t> parse_int(std::string_view text) {
+  int value = 0;
+  auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (ec != std::errc()) {
+    return {0, 0};
+  }
+  return {value, size_t(end - text.data())};
+}
+
+ProcCacheEntry::ProcCacheEntry(IRProc *proc, std::string_view salt,
+                               bool with_lines)
+    : proc_(proc), with_lines_(with_lines) {
+  auto hash = CompileCache::hash(CompileCache::Kind::PROC);
+  hash.add(salt).add(proc->name());
+
+  auto add_arg = [&](IRArg arg) {
+    hash.add((int64_t)arg.type());
+    switch (arg.type()) {
+    case IRArgType::VARIABLE:
+      hash.add(proc->index(arg.var()));
+      break;
+    case IRArgType::IMD_INT:
+      hash.add(arg.imd_int());
+      break;
+    case IRArgType::IMD_FLOAT:
+      hash.add(std::bit_cast<int64_t>(arg.imd_float()));
+      break;
+    case IRArgType::LABEL:
+      hash.add(label_ordinal(arg.label()));
+      break;
+    case IRArgType::GLOBAL:
+      hash.add(arg.global()->name()).add(arg.global()->size());
+      break;
+    }
+  };
+
+  bool first = true;
+  for (auto &block : proc->blocks()) {
+    hash.add(block->label() ? label_ordinal(block->label()) : -1);
+    hash.add((int64_t)block->size());
+    for (auto &instr : block->instrs()) {
+      if (with_lines_) {
+        if (first) {
+          base_line_ = instr.source_line();
+          first = false;
+        }
+        hash.add(instr.source_line() - base_line_);
+      }
+      hash.add((int64_t)instr.op());
+      if (instr.has_arg1()) {
+        add_arg(instr.arg1());
+      }
+      if (instr.has_arg2()) {
+        add_arg(instr.arg2());
+      }
+      if (instr.has_arg3()) {
+        add_arg(instr.arg3());
+      }
+    }
+  }
+  key_ = hash.hex();
+
+  for (size_t i = 0; i < proc->num_addresses(); i++) {
+    if (auto addr = proc->address(i); addr->is_var()) {
+      var_indices_[addr->var()->id()] = i;
+    }
+  }
+}
+
+int ProcCacheEntry::label_ordinal(IRLabel *label) {
+  auto [it, inserted] = label_ordinals_.emplace(label->id(), labels_.size());
+  if (inserted) {
+    labels_.push_back(label->id());
+  }
+  return it->second;
+}
+
+/* Labels "L12" and vars "%12" become "L#n" and "%#n", n being their number
+ * in the proc, and "; line #12" becomes "; line #~d", d lines from the
+ * proc's first. relocate undoes it. */
+std::string ProcCacheEntry::canonical(std::string_view text) const {
+  std::string out;
+  out.reserve(text.size());
+  for (size_t i = 0; i < text.size();) {
+    if (with_lines_ && text.substr(i).starts_with(LINE_PREFIX)) {
+      i += LINE_PREFIX.size();
+      auto [line, len] = parse_int(text.substr(i));
+      out += LINE_PREFIX;
+      if (len) {
+        out += "~" + std::to_string(line - base_line_);
+      }
+      i += len;
+      continue;
+    }
+    char c = text[i];
+    if ((c == 'L' || c == '%') && (i == 0 || !is_ident(text[i - 1]))) {
+      auto [id, len] = parse_int(text.substr(i + 1));
+      size_t end = i + 1 + len;
+      if (len && (end == text.size() || !is_ident(text[end]))) {
+        auto &numbers = c == 'L' ? label_ordinals_ : var_indices_;
+        if (auto it = numbers.find(id); it != numbers.end()) {
+          out += c;
+          out += "#" + std::to_string(it->second);
+          i = end;
+          continue;
+        }
+      }
+    }
+    out += c;
+    i++;
+  }
+  return out;
+}
+
+std::string ProcCacheEntry::relocate(std::string_view text) const {
+  std::string out;
+  out.reserve(text.size());
+  for (size_t i = 0; i < text.size();) {
+    if (text.substr(i).starts_with(LINE_PREFIX) &&
+        text.substr(i + LINE_PREFIX.size()).starts_with("~")) {
+      i += LINE_PREFIX.size() + 1;
+      auto [delta, len] = parse_int(text.substr(i));
+      out += LINE_PREFIX;
+      out += std::to_string(base_line_ + delta);
+      i += len;
+      continue;
+    }
+    char c = text[i];
+    if ((c == 'L' || c == '%') && i + 1 < text.size() && text[i + 1] == '#' &&
+        (i == 0 || !is_ident(text[i - 1]))) {
+      auto [n, len] = parse_int(text.substr(i + 2));
+      if (c == 'L' && n < (int)labels_.size()) {
+        out += "L" + std::to_string(labels_[n]);
+      } else if (c == '%' && n < (int)proc_->num_addresses()) {
+        out += proc_->address(n)->name();
+      }
+      i += 2 + len;
+      continue;
+    }
+    out += c;
+    i++;
+  }
+  return out;
+}
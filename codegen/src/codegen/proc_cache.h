@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ir/ir_proc.h"
+
+/* Cache key and text relocation for the assembly of one proc.
+ *
+ * What a proc compiles to only depends on the proc itself, its own copies
+ * of globals included, but label and var ids are numbered across the whole
+ * program and source lines shift with every edit above the proc. Both the
+ * key and the stored text use numbers relative to the proc instead: labels
+ * and vars by order of appearance, lines from the proc's first one. So an
+ * edit to one proc leaves the entries of all the others valid. */
+class ProcCacheEntry {
+public:
+  /* salt: whatever else the text depends on, like codegen flags */
+  ProcCacheEntry(IRProc *proc, std::string_view salt, bool with_lines);
+
+  const std::string &key() const { return key_; }
+
+  /* generated text in the proc relative numbering, to be stored */
+  std::string canonical(std::string_view text) const;
+  /* stored text back in the numbering of this program */
+  std::string relocate(std::string_view text) const;
+
+private:
+  int label_ordinal(IRLabel *label);
+
+  IRProc *proc_;
+  std::string key_;
+  /* ids of the labels by order of appearance, and the reverse */
+  std::vector<int> labels_;
+  std::unordered_map<int, int> label_ordinals_;
+  /* IRProc::index of each var referenced by id */
+  std::unordered_map<int, int> var_indices_;
+  bool with_lines_;
+  int base_line_ = 0;
+};
@@ -0,0 +1,212 @@
+#include "reg_alloc.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+RegAlloc::RegAlloc(IRProc *proc, const BitSet &candidates, int colors,
+                   float min_weight)
+    : proc_(proc), candidates_(candidates), colors_(colors),
+      weight_(proc->num_addresses()), adj_(proc->num_addresses()),
+      color_(proc->num_addresses(), -1) {
+  find_loop_depths();
+  weigh(min_weight);
+  build();
+  color();
+}
+
+void RegAlloc::find_loop_depths() {
+  auto &blocks = proc_->blocks();
+  depth_.assign(blocks.size(), 0);
+  if (blocks.empty()) {
+    return;
+  }
+  std::unordered_map<IRBlock *, size_t> position;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    position[blocks[i].get()] = i;
+  }
+
+  /* an edge to a block still on the depth first stack closes a loop; the
+   * loop is everything that reaches the edge without passing the header */
+  std::vector<bool> visited(blocks.size()), on_stack(blocks.size());
+  std::vector<std::pair<IRBlock *, IRBlock *>> back_edges;
+  std::vector<std::pair<IRBlock *, size_t>> stack{{blocks[0].get(), 0}};
+  visited[0] = on_stack[0] = true;
+  while (!stack.empty()) {
+    auto &[block, next] = stack.back();
+    if (next < block->successors().size()) {
+      auto succ = block->successors()[next++];
+      size_t i = position[succ];
+      if (on_stack[i]) {
+        back_edges.push_back({block, succ});
+      } else if (!visited[i]) {
+        visited[i] = on_stack[i] = true;
+        stack.push_back({succ, 0});
+      }
+    } else {
+      on_stack[position[block]] = false;
+      stack.pop_back();
+    }
+  }
+
+  for (auto [tail, header] : back_edges) {
+    std::vector<bool> in_loop(blocks.size());
+    in_loop[position[header]] = true;
+    std::vector<IRBlock *> work{tail};
+    while (!work.empty()) {
+      auto block = work.back();
+      work.pop_back();
+      size_t i = position[block];
+      if (in_loop[i]) {
+        continue;
+      }
+      in_loop[i] = true;
+      for (auto pred : block->predecessors()) {
+        work.push_back(pred);
+      }
+    }
+    for (size_t i = 0; i < blocks.size(); i++) {
+      depth_[i] += in_loop[i];
+    }
+  }
+}
+
+void RegAlloc::weigh(float min_weight) {
+  auto &blocks = proc_->blocks();
+  for (size_t b = 0; b < blocks.size(); b++) {
+    float w = std::pow(10.0f, std::min(depth_[b], 4));
+    for (auto &instr : blocks[b]->instrs()) {
+      /* declarations aren't references */
+      if (instr.op() == IROp::ALLOC || instr.op() == IROp::PALLOC) {
+        continue;
+      }
+      for (int k = 0; k < 3; k++) {
+        if (auto addr = instr.operand(k)) {
+          if (candidates_.contains(proc_->index(addr))) {
+            weight_[proc_->index(addr)] += w;
+          }
+        }
+      }
+    }
+  }
+  std::vector<uint32_t> light;
+  candidates_.for_each([&](size_t i) {
+    if (weight_[i] < min_weight) {
+      light.push_back(i);
+    }
+  });
+  for (auto i : light) {
+    candidates_.erase(i);
+  }
+}
+
+void RegAlloc::build() {
+  for (auto &block : proc_->blocks()) {
+    BitSet live(proc_->num_addresses());
+    block->live_on_exit().for_each([&](size_t i) {
+      if (candidates_.contains(i)) {
+        live.insert(i);
+      }
+    });
+
+    auto instrs = block->instrs();
+    for (auto itr = instrs.rbegin(); itr != instrs.rend(); ++itr) {
+      auto &instr = *itr;
+      bool has_dest = instr.dest();
+      size_t d = has_dest ? proc_->index(instr.dest()) : 0;
+      if (has_dest && candidates_.contains(d)) {
+        bool has_src = instr.op() == IROp::COPY && instr.arg2().is_addr();
+        size_t s = has_src ? proc_->index(instr.arg2().addr()) : 0;
+        live.for_each([&](size_t v) {
+          if (v != d && !(has_src && v == s)) {
+            add_edge(d, v);
+          }
+        });
+      }
+      if (has_dest) {
+        live.erase(d);
+      }
+      for (auto src : instr.srcs()) {
+        int i = proc_->index(src);
+        if (candidates_.contains(i)) {
+          live.insert(i);
+        }
+      }
+    }
+  }
+
+  for (auto &adj : adj_) {
+    std::sort(adj.begin(), adj.end());
+    adj.erase(std::unique(adj.begin(), adj.end()), adj.end());
+  }
+}
+
+void RegAlloc::add_edge(uint32_t a, uint32_t b) {
+  adj_[a].push_back(b);
+  adj_[b].push_back(a);
+}
+
+void RegAlloc::color() {
+  std::vector<uint32_t> nodes;
+  candidates_.for_each([&](size_t i) { nodes.push_back(i); });
+
+  /* simplify: take out nodes with fewer neighbours than colors, they can
+   * always be colored; when there are none, take out the cheapest to
+   * leave in memory and hope it still gets a color */
+  std::vector<size_t> degree(adj_.size());
+  std::vector<uint32_t> low;
+  for (auto i : nodes) {
+    degree[i] = adj_[i].size();
+    if (degree[i] < (size_t)colors_) {
+      low.push_back(i);
+    }
+  }
+  auto by_weight = nodes;
+  std::stable_sort(by_weight.begin(), by_weight.end(), [&](auto a, auto b) {
+    return weight_[a] < weight_[b];
+  });
+
+  BitSet removed(adj_.size());
+  std::vector<uint32_t> order;
+  auto remove = [&](uint32_t i) {
+    removed.insert(i);
+    order.push_back(i);
+    for (auto m : adj_[i]) {
+      if (!removed.contains(m) && degree[m]-- == (size_t)colors_) {
+        low.push_back(m);
+      }
+    }
+  };
+  auto cheapest = by_weight.begin();
+  while (order.size() < nodes.size()) {
+    if (!low.empty()) {
+      auto i = low.back();
+      low.pop_back();
+      if (!removed.contains(i)) {
+        remove(i);
+      }
+      continue;
+    }
+    while (removed.contains(*cheapest)) {
+      ++cheapest;
+    }
+    remove(*cheapest);
+  }
+
+  /* select: put them back in reverse, each taking the first color none of
+   * its neighbours has */
+  for (auto itr = order.rbegin(); itr != order.rend(); ++itr) {
+    uint32_t taken = 0;
+    for (auto m : adj_[*itr]) {
+      if (color_[m] >= 0) {
+        taken |= 1u << color_[m];
+      }
+    }
+    for (int c = 0; c < colors_; c++) {
+      if (!(taken & (1u << c))) {
+        color_[*itr] = c;
+        break;
+      }
+    }
+  }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ir/bit_set.h"
+#include "ir/ir_proc.h"
+
+/* Global register allocation by graph coloring (Chaitin-Briggs, with
+ * optimistic coloring) over the value liveness IRProc::process finds.
+ *
+ * Two vars interfere if one is live where the other is defined, except
+ * for the source of a COPY, which holds the same value. Vars that don't
+ * get a color are left where they are, in their stack slots, so nothing is
+ * ever spilled here: the vars that would be spilled are simply the ones
+ * that stay in memory. Which vars are left out, when some must be, is
+ * decided by how often they are referenced, references in loops counting
+ * ten times for every level of nesting. */
+class RegAlloc {
+public:
+  /* colors the vars in candidates (by IRProc::index) with 0 to colors - 1,
+   * leaving those weighing less than min_weight in memory; proc must be
+   * processed */
+  RegAlloc(IRProc *proc, const BitSet &candidates, int colors,
+           float min_weight = 0);
+
+  /* color of the address with index i, -1 if it stays in memory */
+  int color(size_t i) const { return color_[i]; }
+  /* references of the address with index i, weighted by loop depth */
+  float weight(size_t i) const { return weight_[i]; }
+
+private:
+  void find_loop_depths();
+  void weigh(float min_weight);
+  void build();
+  void add_edge(uint32_t a, uint32_t b);
+  void color();
+
+  IRProc *proc_;
+  BitSet candidates_;
+  int colors_;
+
+  /* by position in proc_->blocks() */
+  std::vector<int> depth_;
+  /* by IRProc::index */
+  std::vector<float> weight_;
+  std::vector<std::vector<uint32_t>> adj_;
+  std::vector<int> color_;
+};
@@ -7,9 +7,10 @@ Register::Register(std::string name, float bias)
   reset();
 }
 
-float Register::spill_cost(IRInstr *instr, IRAddress *except, IRAddress *keep) {
+float Register::spill_cost(IRInstr *instr, const NextUse &next_use,
+                           IRAddress *except, IRAddress *keep) {
   float cost = bias_;
-  auto &srcs = instr->srcs();
+  auto srcs = instr->srcs();
   auto dest = instr->dest();
   for (auto addr : addresses_) {
     assert(addr->held_at(this));
@@ -33,7 +34,7 @@ float Register::spill_cost(IRInstr *instr, IRAddress *except, IRAddress *keep) {
       continue;
     }
     /* there is no use (without re-assignment) of addr */
-    if (!instr->next_use().contains(addr)) {
+    if (!next_use.used_again(instr, addr)) {
       continue;
     }
 
@@ -47,14 +48,15 @@ float Register::spill_cost(IRInstr *instr, IRAddress *except, IRAddress *keep) {
 }
 
 Register *Register::min_spill_reg(std::initializer_list<Register *> list,
-                                  IRInstr *instr, Register *skip,
-                                  IRAddress *except, IRAddress *keep) {
+                                  IRInstr *instr, const NextUse &next_use,
+                                  Register *skip, IRAddress *except,
+                                  IRAddress *keep) {
   assert(list.size());
   float min_cost = 1e9;
   Register *min = nullptr;
   for (auto *reg : list) {
     if (reg != skip) {
-      float cost = reg->spill_cost(instr, except, keep);
+      float cost = reg->spill_cost(instr, next_use, except, keep);
       if (cost < min_cost) {
         min_cost = cost;
         min = reg;
@@ -66,14 +68,14 @@ Register *Register::min_spill_reg(std::initializer_list<Register *> list,
 
 Register *
 Register::min_spill_reg(const std::vector<std::unique_ptr<Register>> &list,
-                        IRInstr *instr, Register *skip, IRAddress *except,
-                        IRAddress *keep) {
+                        IRInstr *instr, const NextUse &next_use,
+                        Register *skip, IRAddress *except, IRAddress *keep) {
   assert(list.size());
   float min_cost = 1e9;
   Register *min = nullptr;
   for (auto &reg : list) {
     if (reg.get() != skip) {
-      float cost = reg->spill_cost(instr, except, keep);
+      float cost = reg->spill_cost(instr, next_use, except, keep);
       if (cost < min_cost) {
         min_cost = cost;
         min = reg.get();
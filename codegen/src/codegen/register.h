@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "ir/ir_instr.h"
+#include "ir/next_use.h"
 
 class IRAddress;
 
@@ -12,22 +13,26 @@ class Register {
 public:
   Register(std::string name, float bias);
 
-  float spill_cost(IRInstr *instr, IRAddress *except = nullptr,
-                   IRAddress *keep = nullptr);
+  float spill_cost(IRInstr *instr, const NextUse &next_use,
+                   IRAddress *except = nullptr, IRAddress *keep = nullptr);
 
   std::string_view name() {
     accessed_ = true;
     return name_;
   }
+  /* the proc uses the register, so it saves and restores it */
+  void access() { accessed_ = true; }
 
   static Register *min_spill_reg(std::initializer_list<Register *> list,
-                                 IRInstr *instr, Register *skip = nullptr,
+                                 IRInstr *instr, const NextUse &next_use,
+                                 Register *skip = nullptr,
                                  IRAddress *except = nullptr,
                                  IRAddress *keep = nullptr);
   static Register *
   min_spill_reg(const std::vector<std::unique_ptr<Register>> &list,
-                IRInstr *instr, Register *skip = nullptr,
-                IRAddress *except = nullptr, IRAddress *keep = nullptr);
+                IRInstr *instr, const NextUse &next_use,
+                Register *skip = nullptr, IRAddress *except = nullptr,
+                IRAddress *keep = nullptr);
 
   void add_address(IRAddress *addr, bool update_addr = true);
   void remove_address(IRAddress *addr, bool update_addr = true);
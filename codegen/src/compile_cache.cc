@@ -0,0 +1,82 @@
+#include "compile_cache.h"
+
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static std::optional<std::string> read_file(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return std::nullopt;
+  }
+  return std::string(std::istreambuf_iterator<char>(in),
+                     std::istreambuf_iterator<char>());
+}
+
+CompileCache::CompileCache(std::string dir) : dir_(std::move(dir)) {}
+
+const std::string &CompileCache::compiler_id() {
+  static const std::string id = [] {
+    if (auto exe = read_file("/proc/self/exe")) {
+      return ContentHash().add(*exe).hex();
+    }
+    /* no way to tell builds apart, at least tell releases apart */
+    return std::string(__DATE__ " " __TIME__);
+  }();
+  return id;
+}
+
+ContentHash CompileCache::hash(Kind kind) {
+  ContentHash hash;
+  hash.add(compiler_id()).add((int64_t)kind);
+  return hash;
+}
+
+/* entries are spread over 256 subdirectories by their first two digits */
+std::string CompileCache::path(const std::string &key) {
+  return dir_ + "/" + key.substr(0, 2) + "/" + key.substr(2);
+}
+
+std::optional<std::string> CompileCache::load(Kind kind,
+                                              const std::string &key) {
+  auto data = read_file(path(key));
+  (data ? hits_ : misses_)[(int)kind]++;
+  return data;
+}
+
+void CompileCache::reject(Kind kind) {
+  hits_[(int)kind]--;
+  misses_[(int)kind]++;
+}
+
+void CompileCache::store(const std::string &key, std::string_view data) {
+  /* best effort, a cache that can't be written is just always missed */
+  auto dest = path(key);
+  auto tmp = fmt::format("{}.{}.{}.tmp", dest, getpid(), stores_++);
+  std::error_code ec;
+  fs::create_directories(fs::path(dest).parent_path(), ec);
+  {
+    std::ofstream out(tmp, std::ios::binary);
+    if (!out.write(data.data(), data.size())) {
+      fs::remove(tmp, ec);
+      return;
+    }
+  }
+  fs::rename(tmp, dest, ec);
+  if (ec) {
+    fs::remove(tmp, ec);
+  }
+}
+
+void CompileCache::print_stats(std::FILE *out) {
+  fmt::print(out, "{:<20} {:>8} {:>8}\n", "cache", "hits", "misses");
+  const char *names[] = {"units", "procs"};
+  for (int kind = 0; kind < 2; kind++) {
+    fmt::print(out, "{:<20} {:>8} {:>8}\n", names[kind], hits_[kind].load(),
+               misses_[kind].load());
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "content_hash.h"
+
+/* Compiled output kept on disk, one file per entry, named by a ContentHash
+ * of everything the output depends on. Entries are written to a temporary
+ * file and renamed into place, so units compiled concurrently, in this
+ * process or another one sharing the directory, never see half an entry. */
+class CompileCache {
+public:
+  /* whole translation units, or single procs */
+  enum class Kind { UNIT, PROC };
+
+  explicit CompileCache(std::string dir);
+
+  /* hash to build the key of an entry of kind on, seeded with the
+   * compiler's identity */
+  static ContentHash hash(Kind kind);
+
+  /* entry under key if there is one, counted as a hit or a miss */
+  std::optional<std::string> load(Kind kind, const std::string &key);
+  /* an entry from load the caller couldn't use, recounted as a miss */
+  void reject(Kind kind);
+  void store(const std::string &key, std::string_view data);
+
+  void print_stats(std::FILE *out);
+
+private:
+  /* hash of the running executable, so a rebuilt compiler never reads
+   * entries of an older one */
+  static const std::string &compiler_id();
+
+  std::string path(const std::string &key);
+
+  std::string dir_;
+  std::atomic<size_t> hits_[2] = {};
+  std::atomic<size_t> misses_[2] = {};
+  /* names temporary files apart */
+  std::atomic<size_t> stores_ = 0;
+};
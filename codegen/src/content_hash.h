@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/* 128 bit FNV-1a, for naming cache entries after their contents. Every
+ * field is fed with its length, so ("ab", "c") and ("a", "bc") differ. */
+class ContentHash {
+public:
+  ContentHash &add(std::string_view data) {
+    add_bytes(data.size());
+    for (unsigned char c : data) {
+      hash_ = (hash_ ^ c) * PRIME;
+    }
+    return *this;
+  }
+
+  ContentHash &add(int64_t value) {
+    add_bytes(value);
+    return *this;
+  }
+
+  /* 32 hex digits */
+  std::string hex() const {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string str(32, '0');
+    auto h = hash_;
+    for (int i = 31; i >= 0; i--, h >>= 4) {
+      str[i] = digits[h & 0xf];
+    }
+    return str;
+  }
+
+private:
+  using Word = unsigned __int128;
+
+  static constexpr Word PRIME = (Word(1) << 88) + 0x13b;
+  static constexpr Word OFFSET =
+      (Word(0x6c62272e07bb0142) << 64) + 0x62b821756295c58d;
+
+  void add_bytes(uint64_t value) {
+    for (int i = 0; i < 8; i++, value >>= 8) {
+      hash_ = (hash_ ^ (value & 0xff)) * PRIME;
+    }
+  }
+
+  Word hash_ = OFFSET;
+};
@@ -1,9 +1,12 @@
 
+#include <algorithm>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fmt/core.h>
 #include <iostream>
 #include <optional>
+#include <string_view>
 #include <tuple>
 
 #include "codegen/8086/preprocessor.h"
@@ -16,30 +19,87 @@ int main(int argc, char **argv) {
   const char *in_file = "../sample_input.txt";
   const char *out_file = "token.txt";
   const char *log_file = "log.txt";
+  bool binary = false;
+  int jobs = 1;
+  /* log.txt, ast.txt, err.txt; the parse tree (pt.txt) is only built on
+   * request */
+  bool log = true, ast = true, pt = false, err = true;
+  LogLevel log_level = LogLevel::TRACE;
   // set input and output from command line
-  for (int i = 1; i < argc - 1; i++) {
-    if (std::strcmp(argv[i], "-i") == 0) {
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
       in_file = argv[i + 1];
     }
+    if (std::strcmp(argv[i], "--irb") == 0) {
+      binary = true;
+    }
+    if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      jobs = std::max(1, std::atoi(argv[i + 1]));
+    }
+    if (std::strcmp(argv[i], "--no-log") == 0) {
+      log = false;
+    }
+    if (std::strcmp(argv[i], "--no-ast") == 0) {
+      ast = false;
+    }
+    if (std::strcmp(argv[i], "--pt") == 0) {
+      pt = true;
+    }
+    if (std::strcmp(argv[i], "--no-err") == 0) {
+      err = false;
+    }
+    /* info: scope tables and summary, debug: + grammar rules,
+     * trace: + tokens */
+    if (std::strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+      std::string_view level = argv[i + 1];
+      if (level == "off") {
+        log_level = LogLevel::OFF;
+      } else if (level == "info") {
+        log_level = LogLevel::INFO;
+      } else if (level == "debug") {
+        log_level = LogLevel::DEBUG;
+      } else if (level == "trace") {
+        log_level = LogLevel::TRACE;
+      } else {
+        fmt::print(stderr, "Unknown log level: {}\n", level);
+      }
+    }
   }
 
-  std::FILE *in = std::fopen(in_file, "r");
+  auto source = std::make_unique<SourceBuffer>(in_file);
 
-  if (in) {
-    preprocess(in_file, "cp.c");
-    ParserContext context(std::fopen("cp.c", "r"));
-    context.set_ast_logger_file("ast.txt");
-    context.set_pt_logger_file("pt.txt");
-    context.set_logger_file("log.txt");
-    context.set_error_logger_file("err.txt");
+  if (source->valid()) {
+    ParserContext context(std::move(source), built_in_headers);
+    auto open_log = [](Logger *logger, bool on, const char *path) {
+      if (on) {
+        logger->set_out_file(path);
+      } else {
+        logger->disable();
+      }
+    };
+    open_log(context.ast_logger(), ast, "ast.txt");
+    open_log(context.pt_logger(), pt, "pt.txt");
+    open_log(context.logger(), log, "log.txt");
+    open_log(context.error_logger(), err, "err.txt");
+    if (log) {
+      context.logger()->set_level(log_level);
+    }
+    context.build_pt(pt);
     context.parse();
     context.print_ast();
     context.print_pt();
 
-    auto out = std::string(base_name(in_file)) + ".ir";
-
-    IRGenerator ir_gen(out.c_str());
-    ir_gen.generate(context.ast_root());
+    if (binary) {
+      auto out = std::string(base_name(in_file)) + ".irb";
+      IRBinaryWriter writer;
+      IRGenerator ir_gen(&writer);
+      ir_gen.generate(context.ast_root(), jobs);
+      writer.write(out.c_str());
+    } else {
+      auto out = std::string(base_name(in_file)) + ".ir";
+      IRGenerator ir_gen(out.c_str());
+      ir_gen.generate(context.ast_root(), jobs);
+    }
   } else {
     fmt::print(stderr, "Couldn't access input file: {}", in_file);
   }
@@ -0,0 +1,35 @@
+#include "interner.h"
+#include "sdbm_hash.h"
+
+Interner &Interner::instance() {
+  static Interner interner;
+  return interner;
+}
+
+Name Interner::intern(std::string_view str) {
+  auto &self = instance();
+  std::lock_guard lock(self.mutex_);
+  if (auto it = self.entries_.find(str); it != self.entries_.end()) {
+    return Name(it->second);
+  }
+  auto copy = self.arena_.copy_string(str);
+  auto entry = self.arena_.create<Name::Entry>(
+      copy, sdbm_hash(copy), (uint32_t)self.entries_.size() + 1);
+  self.entries_.emplace(copy, entry);
+  return Name(entry);
+}
+
+Name Interner::find(std::string_view str) {
+  auto &self = instance();
+  std::lock_guard lock(self.mutex_);
+  if (auto it = self.entries_.find(str); it != self.entries_.end()) {
+    return Name(it->second);
+  }
+  return Name();
+}
+
+size_t Interner::size() {
+  auto &self = instance();
+  std::lock_guard lock(self.mutex_);
+  return self.entries_.size();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include "arena.h"
+
+/* Handle to an interned string. Equal strings share one handle, so names
+ * compare by pointer, and the hash is computed once when interning. */
+class Name {
+  friend class Interner;
+
+public:
+  Name() = default;
+
+  std::string_view str() const { return entry_ ? entry_->str : ""; }
+  /* raw sdbm hash of the string */
+  size_t hash() const { return entry_ ? entry_->hash : 0; }
+  uint32_t id() const { return entry_ ? entry_->id : 0; }
+
+  /* null handle, e.g. a name that was never interned */
+  explicit operator bool() const { return entry_; }
+
+  bool operator==(const Name &other) const { return entry_ == other.entry_; }
+
+private:
+  struct Entry {
+    std::string_view str;
+    size_t hash;
+    uint32_t id;
+  };
+
+  Name(const Entry *entry) : entry_(entry) {}
+
+  const Entry *entry_ = nullptr;
+};
+
+/* process wide string table, safe to use from multiple threads */
+class Interner {
+public:
+  static Name intern(std::string_view str);
+  /* handle of str if it was interned before, null handle otherwise */
+  static Name find(std::string_view str);
+  static size_t size();
+
+private:
+  static Interner &instance();
+
+  std::mutex mutex_;
+  Arena arena_;
+  std::unordered_map<std::string_view, const Name::Entry *> entries_;
+};
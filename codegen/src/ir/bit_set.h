@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/* Dense set of small non negative integers, one bit each, packed in 64 bit
+ * words. The set operations are plain loops over the words with no
+ * branches in the body, so the compiler vectorises them. Sets of different
+ * sizes can be mixed, missing bits read as zero.
+ *
+ * A single word is kept inline, so sets over at most 64 elements (the
+ * addresses of most procs) don't allocate. */
+class BitSet {
+public:
+  using Word = uint64_t;
+  static constexpr size_t WORD_BITS = 64;
+
+  BitSet() : inline_(0) {}
+  explicit BitSet(size_t size) : BitSet() { resize(size); }
+  ~BitSet() { release(); }
+
+  BitSet(const BitSet &other) : BitSet() { *this = other; }
+  BitSet(BitSet &&other) : nwords_(other.nwords_), inline_(other.inline_) {
+    other.nwords_ = 0;
+    other.inline_ = 0;
+  }
+
+  BitSet &operator=(const BitSet &other) {
+    if (this != &other) {
+      resize(other.nwords_ * WORD_BITS);
+      std::copy_n(other.words(), nwords_, words());
+    }
+    return *this;
+  }
+  BitSet &operator=(BitSet &&other) {
+    if (this != &other) {
+      release();
+      nwords_ = std::exchange(other.nwords_, 0);
+      inline_ = std::exchange(other.inline_, 0);
+    }
+    return *this;
+  }
+
+  /* number of bits, not elements */
+  size_t size() const { return nwords_ * WORD_BITS; }
+
+  void resize(size_t size) {
+    size_t nwords = (size + WORD_BITS - 1) / WORD_BITS;
+    if (nwords == nwords_) {
+      return;
+    }
+    Word *words = nwords > 1 ? new Word[nwords]() : nullptr;
+    Word small = 0;
+    std::copy_n(this->words(), std::min(nwords, nwords_),
+                words ? words : &small);
+    release();
+    nwords_ = nwords;
+    if (words) {
+      heap_ = words;
+    } else {
+      inline_ = small;
+    }
+  }
+
+  void insert(size_t i) {
+    if (i >= size()) {
+      resize(i + 1);
+    }
+    words()[i / WORD_BITS] |= Word(1) << (i % WORD_BITS);
+  }
+
+  void erase(size_t i) {
+    if (i < size()) {
+      words()[i / WORD_BITS] &= ~(Word(1) << (i % WORD_BITS));
+    }
+  }
+
+  bool contains(size_t i) const {
+    return i < size() && (words()[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+  }
+
+  /* empty the set, keeping its size */
+  void clear() { std::fill_n(words(), nwords_, 0); }
+
+  bool empty() const {
+    return std::all_of(words(), words() + nwords_,
+                       [](Word w) { return w == 0; });
+  }
+
+  size_t count() const {
+    size_t n = 0;
+    for (size_t i = 0; i < nwords_; i++) {
+      n += std::popcount(words()[i]);
+    }
+    return n;
+  }
+
+  /* this ∪= other */
+  void unite(const BitSet &other) {
+    if (other.nwords_ > nwords_) {
+      resize(other.size());
+    }
+    Word *w = words();
+    const Word *o = other.words();
+    for (size_t i = 0; i < other.nwords_; i++) {
+      w[i] |= o[i];
+    }
+  }
+
+  /* this −= other */
+  void subtract(const BitSet &other) {
+    size_t n = std::min(nwords_, other.nwords_);
+    Word *w = words();
+    const Word *o = other.words();
+    for (size_t i = 0; i < n; i++) {
+      w[i] &= ~o[i];
+    }
+  }
+
+  /* this = a ∪ (b − c), the usual dataflow transfer function. Returns
+   * whether this changed. All three must be at least as large as this. */
+  bool assign_union_difference(const BitSet &a, const BitSet &b,
+                               const BitSet &c) {
+    assert(a.nwords_ >= nwords_ && b.nwords_ >= nwords_ &&
+           c.nwords_ >= nwords_);
+    Word *w = words();
+    const Word *wa = a.words(), *wb = b.words(), *wc = c.words();
+    Word changed = 0;
+    for (size_t i = 0; i < nwords_; i++) {
+      Word n = wa[i] | (wb[i] & ~wc[i]);
+      changed |= n ^ w[i];
+      w[i] = n;
+    }
+    return changed;
+  }
+
+  /* smallest element, size() if empty */
+  size_t first() const {
+    for (size_t i = 0; i < nwords_; i++) {
+      if (words()[i]) {
+        return i * WORD_BITS + std::countr_zero(words()[i]);
+      }
+    }
+    return size();
+  }
+
+  /* call f with every element, in increasing order */
+  template <class F> void for_each(F f) const {
+    for (size_t i = 0; i < nwords_; i++) {
+      for (Word w = words()[i]; w; w &= w - 1) {
+        f(i * WORD_BITS + std::countr_zero(w));
+      }
+    }
+  }
+
+  bool operator==(const BitSet &other) const {
+    size_t n = std::min(nwords_, other.nwords_);
+    auto rest_empty = [n](const BitSet &set) {
+      return std::all_of(set.words() + n, set.words() + set.nwords_,
+                         [](Word w) { return w == 0; });
+    };
+    return std::equal(words(), words() + n, other.words()) &&
+           rest_empty(*this) && rest_empty(other);
+  }
+
+private:
+  Word *words() { return nwords_ > 1 ? heap_ : &inline_; }
+  const Word *words() const { return nwords_ > 1 ? heap_ : &inline_; }
+
+  void release() {
+    if (nwords_ > 1) {
+      delete[] heap_;
+    }
+  }
+
+  size_t nwords_ = 0;
+  union {
+    Word inline_;
+    Word *heap_;
+  };
+};
@@ -0,0 +1,273 @@
+#include "dce.h"
+#include "next_use.h"
+#include "sccp.h"
+#include "ssa.h"
+
+#include <unordered_map>
+
+static bool is_comparison(IROp op) {
+  switch (op) {
+  case IROp::LESS:
+  case IROp::LEQ:
+  case IROp::GREAT:
+  case IROp::GEQ:
+  case IROp::EQ:
+  case IROp::NEQ:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* all instr does is write its destination */
+static bool is_pure(const IRInstr &instr) {
+  switch (instr.op()) {
+  case IROp::PTRLD:
+  case IROp::COPY:
+  case IROp::ADD:
+  case IROp::INC:
+  case IROp::DEC:
+  case IROp::NEG:
+  case IROp::AND:
+  case IROp::OR:
+  case IROp::XOR:
+  case IROp::NOT:
+  case IROp::SUB:
+  case IROp::MUL:
+  case IROp::DIV:
+  case IROp::MOD:
+  case IROp::LSHIFT:
+  case IROp::RSHIFT:
+    return true;
+  default:
+    return is_comparison(instr.op());
+  }
+}
+
+static bool is_declaration(const IRInstr &instr) {
+  return instr.op() == IROp::ALLOC || instr.op() == IROp::AALLOC ||
+         instr.op() == IROp::PALLOC;
+}
+
+DCE::DCE(IRProc *proc) : proc_(proc), first_block_(proc->num_addresses()) {
+  before_ = count();
+  find_scalars();
+  proc_->find_first_defs();
+  for (auto &block : proc_->blocks()) {
+    block->first_def_.for_each([&](size_t i) { first_block_[i] = block.get(); });
+  }
+  for (bool changed = true; changed;) {
+    rounds_++;
+    changed = propagate();
+    changed = eliminate() || changed;
+  }
+  drop_declarations();
+  after_ = count();
+}
+
+void DCE::find_scalars() {
+  scalars_ = BitSet(proc_->num_addresses());
+  removable_ = BitSet(proc_->num_addresses());
+  BitSet excluded(proc_->num_addresses()), comparisons(proc_->num_addresses());
+  for (auto &block : proc_->blocks()) {
+    for (auto &instr : block->instrs()) {
+      switch (instr.op()) {
+      case IROp::PTRLD:
+      case IROp::PTRST:
+        excluded.insert(proc_->index(instr.arg2().addr()));
+        break;
+      case IROp::ADDR:
+        if (instr.arg2().is_addr()) {
+          excluded.insert(proc_->index(instr.arg2().addr()));
+        }
+        [[fallthrough]];
+      case IROp::AALLOC:
+        excluded.insert(proc_->index(instr.arg1().addr()));
+        break;
+      default:
+        if (is_comparison(instr.op())) {
+          comparisons.insert(proc_->index(instr.arg1().addr()));
+        }
+        break;
+      }
+      for (int k = 0; k < 3; k++) {
+        if (auto addr = instr.operand(k)) {
+          scalars_.insert(proc_->index(addr));
+        }
+      }
+    }
+  }
+  scalars_.subtract(excluded);
+  scalars_.subtract(comparisons);
+
+  scalars_.for_each([&](size_t i) {
+    if (proc_->address(i)->is_var()) {
+      removable_.insert(i);
+    }
+  });
+  comparisons.subtract(excluded);
+  removable_.unite(comparisons);
+}
+
+bool DCE::propagate() {
+  bool changed = false;
+  for (auto &block : proc_->blocks()) {
+    /* what each var holds a copy of, by IRProc::index */
+    std::unordered_map<int, IRArg> copies;
+    bool forwarded = false;
+    for (auto &instr : block->instrs()) {
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (!addr || SSA::writes(instr, k)) {
+          continue;
+        }
+        auto itr = copies.find(proc_->index(addr));
+        if (itr != copies.end() &&
+            (itr->second.is_addr() || SCCP::takes_immediate(instr, k))) {
+          instr.set_arg(k, itr->second);
+          forwarded = true;
+        }
+      }
+
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (!addr || !SSA::writes(instr, k)) {
+          continue;
+        }
+        int i = proc_->index(addr);
+        std::erase_if(copies, [&](auto &copy) {
+          return copy.first == i || (copy.second.is_addr() &&
+                                     proc_->index(copy.second.addr()) == i);
+        });
+      }
+      if (instr.op() == IROp::CALL || instr.op() == IROp::PTRST) {
+        /* the callee, or the pointer, could write a global */
+        std::erase_if(copies,
+                      [](auto &copy) { return copy.second.is_global(); });
+      }
+
+      if (instr.op() == IROp::COPY && instr.arg1().is_var() &&
+          scalars_.contains(proc_->index(instr.arg1().addr()))) {
+        auto src = instr.arg2();
+        if (src.is_imd_int() ||
+            (src.is_addr() && scalars_.contains(proc_->index(src.addr())) &&
+             src.addr() != instr.arg1().addr())) {
+          copies[proc_->index(instr.arg1().addr())] = src;
+        }
+      }
+    }
+    if (forwarded) {
+      block->find_refs();
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+bool DCE::eliminate() {
+  proc_->find_liveness();
+  proc_->find_next_use();
+
+  auto is_dead = [&](const IRInstr &instr) {
+    if (!is_pure(instr) || !instr.arg1().is_var() ||
+        !removable_.contains(proc_->index(instr.arg1().addr()))) {
+      return false;
+    }
+    return instr.next_use(0) == NextUse::DEAD ||
+           (instr.op() == IROp::COPY && instr.arg2().is_addr() &&
+            instr.arg2().addr() == instr.arg1().addr());
+  };
+
+  bool changed = false;
+  auto &blocks = proc_->blocks();
+  std::vector<std::vector<IRInstr>> instrs(blocks.size());
+  for (size_t b = 0; b < blocks.size(); b++) {
+    auto block = blocks[b].get();
+    /* vars first referenced in this block that have been by the time an
+     * instruction is reached; declarations are never deleted, so they
+     * count from the start */
+    BitSet seen(proc_->num_addresses());
+    for (auto &instr : block->instrs()) {
+      if (is_declaration(instr)) {
+        seen.insert(proc_->index(instr.arg1().addr()));
+      }
+    }
+    auto first_here = [&](IRAddress *addr) {
+      size_t i = proc_->index(addr);
+      return addr->is_var() && first_block_[i] == block && !seen.contains(i);
+    };
+
+    auto &out = instrs[b];
+    for (auto &instr : block->instrs()) {
+      if (is_dead(instr)) {
+        bool first_read = false;
+        for (auto src : instr.srcs()) {
+          first_read = first_read || first_here(src);
+        }
+        if (!first_read) {
+          changed = true;
+          if (first_here(instr.arg1().addr())) {
+            IRInstr decl(IROp::ALLOC, instr.arg1());
+            decl.set_source_line(instr.source_line());
+            out.push_back(decl);
+            seen.insert(proc_->index(instr.arg1().addr()));
+          }
+          continue;
+        }
+      }
+      for (int k = 0; k < 3; k++) {
+        if (auto addr = instr.operand(k)) {
+          seen.insert(proc_->index(addr));
+        }
+      }
+      out.push_back(instr);
+    }
+  }
+  if (changed) {
+    proc_->set_instrs(std::move(instrs));
+  }
+  return changed;
+}
+
+void DCE::drop_declarations() {
+  auto &blocks = proc_->blocks();
+  std::vector<size_t> refs(proc_->num_addresses());
+  for (auto &block : blocks) {
+    for (auto &instr : block->instrs()) {
+      if (instr.op() == IROp::ALLOC) {
+        continue;
+      }
+      for (int k = 0; k < 3; k++) {
+        if (auto addr = instr.operand(k)) {
+          refs[proc_->index(addr)]++;
+        }
+      }
+    }
+  }
+
+  bool dropped = false;
+  std::vector<std::vector<IRInstr>> instrs(blocks.size());
+  for (size_t b = 0; b < blocks.size(); b++) {
+    for (auto &instr : blocks[b]->instrs()) {
+      if (instr.op() == IROp::ALLOC &&
+          !refs[proc_->index(instr.arg1().addr())]) {
+        dropped = true;
+        continue;
+      }
+      instrs[b].push_back(instr);
+    }
+  }
+  if (dropped) {
+    proc_->set_instrs(std::move(instrs));
+  }
+}
+
+size_t DCE::count() {
+  size_t n = 0;
+  for (auto &block : proc_->blocks()) {
+    for (auto &instr : block->instrs()) {
+      n += !is_declaration(instr);
+    }
+  }
+  return n;
+}
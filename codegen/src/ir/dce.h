@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+
+#include "bit_set.h"
+#include "ir_proc.h"
+
+/* Copy propagation and dead code elimination over a proc out of SSA form.
+ *
+ * Within a block, a read of a var holding a copy is replaced by what it is
+ * a copy of: a var, a global or, where the code generator takes one, an
+ * immediate. This lasts until either is written again or, for a global,
+ * until a call could write it. Copies aren't followed across blocks; --ssa
+ * merges those that can be merged already.
+ *
+ * Then an instruction without side effects is deleted if its destination
+ * is never read again, which its next use tells (IRBlock::find_next_use).
+ * Calls, pointer stores, parameters, returns and jumps are kept, and so
+ * are writes to globals, to arrays and to vars whose address is taken.
+ * Both steps repeat, finding liveness again in between, until nothing
+ * changes.
+ *
+ * The stack frame is laid out from the block each var is first referenced
+ * in (IRProc::find_first_defs), and that block must keep a reference.
+ * So a dead definition that is the first reference there becomes a
+ * declaration, and an instruction holding the first read of a var there
+ * is kept. Declarations of vars nothing else references go at the end. */
+class DCE {
+public:
+  /* the proc must have its flow graph built */
+  explicit DCE(IRProc *proc);
+
+  /* instructions before and after, declarations aside */
+  size_t before() { return before_; }
+  size_t after() { return after_; }
+  /* times both steps ran */
+  size_t rounds() { return rounds_; }
+
+private:
+  void find_scalars();
+  bool propagate();
+  bool eliminate();
+  void drop_declarations();
+  size_t count();
+
+  IRProc *proc_;
+  /* vars and globals only ever read and written directly, by
+   * IRProc::index; copies are followed between these */
+  BitSet scalars_;
+  /* vars whose dead definitions can go: the scalars and the results of
+   * comparisons */
+  BitSet removable_;
+  /* block each var is first referenced in, by IRProc::index */
+  std::vector<IRBlock *> first_block_;
+
+  size_t before_ = 0;
+  size_t after_ = 0;
+  size_t rounds_ = 0;
+};
@@ -5,6 +5,8 @@
 #include <set>
 #include <string>
 
+#include "interner.h"
+
 class Register;
 
 enum class IRAddressType { GLOBAL, LOCAL };
@@ -13,8 +15,8 @@ class IRVar;
 class IRGlobal;
 class IRAddress {
 public:
-  IRAddress(IRAddressType type, std::string name)
-      : type_(type), name_(std::move(name)) {}
+  IRAddress(IRAddressType type, std::string_view name)
+      : type_(type), name_(Interner::intern(name)) {}
 
   IRAddressType type() { return type_; }
 
@@ -39,7 +41,7 @@ public:
   int reg_count() { return registers_.size(); }
   const std::set<Register *> &registers() { return registers_; }
 
-  std::string_view name() { return name_; }
+  std::string_view name() { return name_.str(); }
 
   void reset() {
     clear_registers();
@@ -51,30 +53,39 @@ protected:
   bool is_const_;
   int cnst_;
   std::set<Register *> registers_;
-  std::string name_;
+  Name name_;
 
   bool dirty_ = false;
 };
 
 class IRGlobal : public IRAddress {
-  friend class IRParser;
+  friend class IRBuilder;
 
 public:
-  IRGlobal(std::string name)
-      : IRAddress(IRAddressType::GLOBAL, std::move(name)), size_(0) {}
+  IRGlobal(std::string name, int id)
+      : IRAddress(IRAddressType::GLOBAL, name), size_(0), id_(id) {}
 
   int size() { return size_; }
 
+  /* dense, in order of creation */
+  int id() { return id_; }
+
 private:
   void set_size(int size) { size_ = size; }
 
   int size_;
+  int id_;
 };
 
 class IRVar : public IRAddress {
 public:
   IRVar(int id)
       : IRAddress(IRAddressType::LOCAL, "%" + std::to_string(id)), id_(id) {}
+  /* a version of var made by SSA construction, named %id.version */
+  IRVar(IRVar *var, int version)
+      : IRAddress(IRAddressType::LOCAL, "%" + std::to_string(var->id()) +
+                                            "." + std::to_string(version)),
+        id_(var->id()) {}
 
   int size() const { return size_; }
   void set_size(int size) { size_ = size; }
@@ -91,8 +102,13 @@ public:
 
   int id() { return id_; }
 
+  /* index in the owning proc's address numbering, see IRProc::index */
+  int index() const { return index_; }
+  void set_index(int index) { index_ = index; }
+
 private:
   int id_;
+  int index_ = -1;
   int size_ = 1;
   int use_ = 0;
 
@@ -0,0 +1,646 @@
+#include "ir_binary.h"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "parse_utils.h"
+
+namespace {
+
+void put_u32(std::string &out, uint32_t v) {
+  for (int i = 0; i < 4; i++) {
+    out.push_back(char((v >> (8 * i)) & 0xff));
+  }
+}
+
+void put_varint(std::string &out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(char((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  out.push_back(char(v));
+}
+
+uint64_t zigzag(int64_t v) { return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+int64_t unzigzag(uint64_t v) { return int64_t(v >> 1) ^ -int64_t(v & 1); }
+
+void put_operand(std::string &out, irb::Tag tag, uint64_t payload) {
+  put_varint(out, (payload << 3) | uint64_t(tag));
+}
+
+uint32_t get_u32(const uint8_t *p) {
+  return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+         uint32_t(p[3]) << 24;
+}
+
+/* bounds checked cursor over a record stream, reads fail rather than run
+ * past the end */
+class Cursor {
+public:
+  Cursor(const uint8_t *p, const uint8_t *end) : p_(p), end_(end) {}
+
+  bool done() { return p_ >= end_; }
+  const uint8_t *position() { return p_; }
+  size_t remaining() { return end_ - p_; }
+  bool skip(size_t n) {
+    if (n > remaining()) {
+      return false;
+    }
+    p_ += n;
+    return true;
+  }
+
+  bool byte(uint8_t &b) {
+    if (p_ >= end_) {
+      return false;
+    }
+    b = *p_++;
+    return true;
+  }
+
+  bool varint(uint64_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      uint8_t b;
+      if (!byte(b)) {
+        return false;
+      }
+      v |= uint64_t(b & 0x7f) << shift;
+      if (!(b & 0x80)) {
+        return true;
+      }
+    }
+    /* longer than any 64 bit value */
+    return false;
+  }
+
+  bool float64(double &d) {
+    if (remaining() < 8) {
+      return false;
+    }
+    std::memcpy(&d, p_, 8);
+    p_ += 8;
+    return true;
+  }
+
+private:
+  const uint8_t *p_;
+  const uint8_t *end_;
+};
+
+struct Operand {
+  irb::Tag tag;
+  uint64_t payload;
+  double imd_float;
+};
+
+struct Record {
+  IROp op;
+  int line_delta;
+  int nargs;
+  Operand args[3];
+};
+
+/* nullopt if the record is cut short or its opcode or a tag is unknown */
+std::optional<Record> next_record(Cursor &cursor) {
+  Record record;
+  uint8_t head;
+  uint64_t delta;
+  if (!cursor.byte(head) || !cursor.varint(delta) ||
+      (head & 0x3f) > uint8_t(IROp::ADDR)) {
+    return std::nullopt;
+  }
+  record.op = IROp(head & 0x3f);
+  record.nargs = head >> 6;
+  record.line_delta = (int)unzigzag(delta);
+  for (int i = 0; i < record.nargs; i++) {
+    uint64_t v;
+    if (!cursor.varint(v) || (v & 0x7) > uint64_t(irb::Tag::FLOAT)) {
+      return std::nullopt;
+    }
+    auto &arg = record.args[i];
+    arg.tag = irb::Tag(v & 0x7);
+    arg.payload = v >> 3;
+    if (arg.tag == irb::Tag::FLOAT && !cursor.float64(arg.imd_float)) {
+      return std::nullopt;
+    }
+  }
+  /* a label record is just the label */
+  if (record.op == IROp::LABEL &&
+      (record.nargs != 1 || record.args[0].tag != irb::Tag::LABEL)) {
+    return std::nullopt;
+  }
+  return record;
+}
+
+} // namespace
+
+void IRBinaryWriter::add_op(IROp op) {
+  op_ = op;
+  nargs_ = 0;
+  args_.clear();
+  proc_name_ = std::nullopt;
+}
+
+bool IRBinaryWriter::add_arg(std::string_view operand) {
+  if (operand.empty() || nargs_ == 3) {
+    return false;
+  }
+  auto number = [&](size_t skip) {
+    uint64_t value = 0;
+    std::from_chars(operand.data() + skip, operand.data() + operand.size(),
+                    value);
+    return value;
+  };
+  switch (operand[0]) {
+  case '%':
+    put_operand(args_, irb::Tag::VAR, number(1));
+    break;
+  case '@': {
+    auto id = intern(operand.substr(1));
+    if (op_ == IROp::PROC && nargs_ == 0) {
+      proc_name_ = id;
+    }
+    put_operand(args_, irb::Tag::GLOBAL, id);
+  } break;
+  case 'L':
+    put_operand(args_, irb::Tag::LABEL, number(1));
+    break;
+  default: {
+    int64_t value = 0;
+    std::from_chars(operand.data(), operand.data() + operand.size(), value);
+    put_operand(args_, irb::Tag::INT, zigzag(value));
+    nargs_++;
+    return true;
+  }
+  }
+  nargs_++;
+  return true;
+}
+
+bool IRBinaryWriter::add_arg(int64_t imd) {
+  if (nargs_ == 3) {
+    return false;
+  }
+  put_operand(args_, irb::Tag::INT, zigzag(imd));
+  nargs_++;
+  return true;
+}
+
+bool IRBinaryWriter::add_arg(double imd) {
+  if (nargs_ == 3) {
+    return false;
+  }
+  put_operand(args_, irb::Tag::FLOAT, 0);
+  args_.append(reinterpret_cast<const char *>(&imd), 8);
+  nargs_++;
+  return true;
+}
+
+bool IRBinaryWriter::add_label(std::string_view label) {
+  if (label.size() < 2 || label[0] != 'L') {
+    return false;
+  }
+  add_op(IROp::LABEL);
+  add_arg(label);
+  auto &out = stream().data;
+  /* labels don't carry a source line */
+  out.push_back(char(uint8_t(IROp::LABEL) | (1 << 6)));
+  put_varint(out, 0);
+  out += args_;
+  return true;
+}
+
+bool IRBinaryWriter::end_line(int source_line) {
+  if ((op_ == IROp::PROC && (in_proc_ || !proc_name_)) ||
+      (op_ == IROp::ENDP && !in_proc_)) {
+    return false;
+  }
+  if (op_ == IROp::PROC) {
+    procs_.push_back(
+        Proc{*proc_name_, (uint32_t)globals_.data.size(), Stream{}});
+    in_proc_ = true;
+  }
+
+  auto &s = stream();
+  s.data.push_back(char(uint8_t(op_) | (nargs_ << 6)));
+  put_varint(s.data, zigzag(source_line - s.last_line));
+  s.data += args_;
+  s.last_line = source_line;
+
+  if (op_ == IROp::ENDP) {
+    in_proc_ = false;
+  }
+  return true;
+}
+
+IRBinaryWriter::Stream &IRBinaryWriter::stream() {
+  return in_proc_ ? procs_.back().stream : globals_;
+}
+
+uint32_t IRBinaryWriter::intern(std::string_view name) {
+  auto key = std::string(name);
+  if (auto it = string_ids_.find(key); it != string_ids_.end()) {
+    return it->second;
+  }
+  uint32_t id = strings_.size();
+  strings_.push_back(key);
+  string_ids_.emplace(std::move(key), id);
+  return id;
+}
+
+std::string IRBinaryWriter::finish() {
+  std::string strtab;
+  for (auto &str : strings_) {
+    put_varint(strtab, str.size());
+    strtab += str;
+  }
+
+  uint32_t proc_table = irb::HEADER_SIZE;
+  uint32_t strtab_offset = proc_table + procs_.size() * irb::PROC_ENTRY_SIZE;
+  uint32_t globals_offset = strtab_offset + strtab.size();
+  uint32_t procs_offset = globals_offset + globals_.data.size();
+
+  std::string out;
+  out.append(irb::MAGIC, 4);
+  out.push_back(char(irb::VERSION & 0xff));
+  out.push_back(char(irb::VERSION >> 8));
+  out.append(2, '\0');
+  put_u32(out, strtab_offset);
+  put_u32(out, strings_.size());
+  put_u32(out, globals_offset);
+  put_u32(out, globals_.data.size());
+  put_u32(out, procs_.size());
+  put_u32(out, proc_table);
+
+  uint32_t offset = procs_offset;
+  for (auto &proc : procs_) {
+    put_u32(out, proc.name);
+    put_u32(out, offset);
+    put_u32(out, proc.stream.data.size());
+    put_u32(out, proc.globals_before);
+    offset += proc.stream.data.size();
+  }
+
+  out += strtab;
+  out += globals_.data;
+  for (auto &proc : procs_) {
+    out += proc.stream.data;
+  }
+  return out;
+}
+
+bool IRBinaryWriter::write(const char *file) {
+  std::ofstream out_file(file, std::ios::binary);
+  if (!out_file) {
+    return false;
+  }
+  auto data = finish();
+  out_file.write(data.data(), data.size());
+  return (bool)out_file;
+}
+
+IRBinaryReader::IRBinaryReader(const char *file) {
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size >= (off_t)irb::HEADER_SIZE) {
+    void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) {
+      data_ = static_cast<const uint8_t *>(p);
+      size_ = st.st_size;
+    }
+  }
+  close(fd);
+
+  if (!data_ || std::memcmp(data_, irb::MAGIC, 4) != 0 ||
+      (data_[4] | data_[5] << 8) != irb::VERSION) {
+    return;
+  }
+
+  uint32_t strtab_offset = get_u32(data_ + 8);
+  uint32_t strtab_count = get_u32(data_ + 12);
+  globals_offset_ = get_u32(data_ + 16);
+  globals_size_ = get_u32(data_ + 20);
+  uint32_t proc_count = get_u32(data_ + 24);
+  uint32_t proc_table = get_u32(data_ + 28);
+
+  if (proc_table + (uint64_t)proc_count * irb::PROC_ENTRY_SIZE > size_ ||
+      strtab_offset > size_ ||
+      globals_offset_ + (uint64_t)globals_size_ > size_) {
+    return;
+  }
+
+  Cursor cursor(data_ + strtab_offset, data_ + size_);
+  for (uint32_t i = 0; i < strtab_count; i++) {
+    uint64_t len;
+    if (!cursor.varint(len) || cursor.remaining() < len) {
+      return;
+    }
+    strings_.emplace_back(reinterpret_cast<const char *>(cursor.position()),
+                          len);
+    cursor.skip(len);
+  }
+
+  for (uint32_t i = 0; i < proc_count; i++) {
+    auto entry = data_ + proc_table + i * irb::PROC_ENTRY_SIZE;
+    Proc proc{get_u32(entry), get_u32(entry + 4), get_u32(entry + 8),
+              get_u32(entry + 12)};
+    if (proc.name >= strings_.size() ||
+        proc.offset + (uint64_t)proc.size > size_) {
+      return;
+    }
+    procs_.push_back(proc);
+  }
+
+  valid_ = true;
+}
+
+IRBinaryReader::~IRBinaryReader() {
+  if (data_) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+}
+
+bool IRBinaryReader::is_binary(const char *file) {
+  std::ifstream in(file, std::ios::binary);
+  char magic[4] = {};
+  in.read(magic, 4);
+  return in && std::memcmp(magic, irb::MAGIC, 4) == 0;
+}
+
+std::optional<size_t> IRBinaryReader::find_proc(std::string_view name) {
+  for (size_t i = 0; i < procs_.size(); i++) {
+    if (proc_name(i) == name) {
+      return i;
+    }
+  }
+  return std::nullopt;
+}
+
+bool IRBinaryReader::read(IRBuilder *builder) {
+  if (!read_globals(builder)) {
+    return false;
+  }
+  for (size_t i = 0; i < procs_.size(); i++) {
+    if (!read_proc(builder, i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IRBinaryReader::read_globals(IRBuilder *builder) {
+  assert(valid_);
+  /* strtab order is the order of first appearance */
+  for (auto name : strings_) {
+    builder->get_global(std::string(name));
+  }
+  return replay(builder, globals_offset_, globals_size_);
+}
+
+bool IRBinaryReader::read_proc(IRBuilder *builder, size_t i) {
+  assert(valid_ && i < procs_.size());
+  return replay(builder, procs_[i].offset, procs_[i].size);
+}
+
+bool IRBinaryReader::in_range(irb::Tag tag, uint64_t payload) {
+  switch (tag) {
+  case irb::Tag::GLOBAL:
+    return payload < strings_.size();
+  case irb::Tag::VAR:
+  case irb::Tag::LABEL:
+    /* numbered densely from 0 and each takes at least a byte to
+     * reference, so an id that reaches the size of the file is corrupt */
+    return payload < size_;
+  default:
+    return true;
+  }
+}
+
+bool IRBinaryReader::replay(IRBuilder *builder, uint32_t offset,
+                            uint32_t size) {
+  Cursor cursor(data_ + offset, data_ + offset + size);
+  int line = 0;
+  bool in_proc = false;
+  while (!cursor.done()) {
+    auto record = next_record(cursor);
+    if (!record) {
+      return false;
+    }
+    for (int i = 0; i < record->nargs; i++) {
+      if (!in_range(record->args[i].tag, record->args[i].payload)) {
+        return false;
+      }
+    }
+    /* the builder takes declarations and procs on trust */
+    auto &args = record->args;
+    switch (record->op) {
+    case IROp::GLOBAL:
+      if (in_proc || record->nargs != 1 || args[0].tag != irb::Tag::GLOBAL) {
+        return false;
+      }
+      break;
+    case IROp::GLOBALARR:
+      if (in_proc || record->nargs != 2 || args[0].tag != irb::Tag::GLOBAL ||
+          args[1].tag != irb::Tag::INT) {
+        return false;
+      }
+      break;
+    case IROp::PROC:
+      if (in_proc || record->nargs != 1 || args[0].tag != irb::Tag::GLOBAL) {
+        return false;
+      }
+      in_proc = true;
+      break;
+    default:
+      if (!in_proc) {
+        return false;
+      }
+      in_proc = record->op != IROp::ENDP;
+      break;
+    }
+    line += record->line_delta;
+    if (record->op != IROp::LABEL) {
+      builder->add_token(IRToken(record->op));
+    }
+    for (int i = 0; i < record->nargs; i++) {
+      auto &arg = record->args[i];
+      switch (arg.tag) {
+      case irb::Tag::VAR:
+        builder->add_token(IRArg(builder->get_var(arg.payload)));
+        break;
+      case irb::Tag::GLOBAL:
+        builder->add_token(
+            IRArg(builder->get_global(std::string(strings_[arg.payload]))));
+        break;
+      case irb::Tag::LABEL:
+        builder->add_token(IRArg(builder->get_label(arg.payload)));
+        break;
+      case irb::Tag::INT:
+        builder->add_token(IRArg((int)unzigzag(arg.payload)));
+        break;
+      case irb::Tag::FLOAT:
+        builder->add_token(IRArg(arg.imd_float));
+        break;
+      }
+    }
+    if (record->op != IROp::LABEL) {
+      builder->source_line(line);
+    }
+    builder->new_line();
+  }
+  return !in_proc;
+}
+
+bool IRBinaryReader::write_text(std::ostream &os) {
+  assert(valid_);
+  uint32_t globals_done = 0;
+  for (auto &proc : procs_) {
+    /* keep globals where they were relative to the procs */
+    if (proc.globals_before < globals_done ||
+        proc.globals_before > globals_size_ ||
+        !print(os, globals_offset_ + globals_done,
+               proc.globals_before - globals_done)) {
+      return false;
+    }
+    globals_done = proc.globals_before;
+    if (!print(os, proc.offset, proc.size)) {
+      return false;
+    }
+  }
+  return print(os, globals_offset_ + globals_done,
+               globals_size_ - globals_done);
+}
+
+bool IRBinaryReader::print(std::ostream &os, uint32_t offset, uint32_t size) {
+  Cursor cursor(data_ + offset, data_ + offset + size);
+  int line = 0;
+  while (!cursor.done()) {
+    auto record = next_record(cursor);
+    if (!record) {
+      return false;
+    }
+    for (int i = 0; i < record->nargs; i++) {
+      if (!in_range(record->args[i].tag, record->args[i].payload)) {
+        return false;
+      }
+    }
+    line += record->line_delta;
+    /* same layout IRGenerator prints */
+    switch (record->op) {
+    case IROp::LABEL:
+    case IROp::PROC:
+    case IROp::ENDP:
+    case IROp::GLOBAL:
+      break;
+    default:
+      os << "\t";
+    }
+    if (record->op != IROp::LABEL) {
+      os << to_string(record->op);
+    }
+    for (int i = 0; i < record->nargs; i++) {
+      if (record->op != IROp::LABEL) {
+        os << (i == 0 ? " " : ", ");
+      }
+      auto &arg = record->args[i];
+      switch (arg.tag) {
+      case irb::Tag::VAR:
+        os << "%" << arg.payload;
+        break;
+      case irb::Tag::GLOBAL:
+        os << "@" << strings_[arg.payload];
+        break;
+      case irb::Tag::LABEL:
+        os << "L" << arg.payload;
+        break;
+      case irb::Tag::INT:
+        os << unzigzag(arg.payload);
+        break;
+      case irb::Tag::FLOAT:
+        os << arg.imd_float;
+        break;
+      }
+    }
+    if (record->op == IROp::LABEL) {
+      os << ": " << std::endl;
+    } else {
+      os << ";#" << line << std::endl;
+    }
+  }
+  return true;
+}
+
+bool ir_text_to_binary(std::istream &in, IRBinaryWriter *writer) {
+  std::string text;
+  int source_line = 0;
+  while (std::getline(in, text)) {
+    std::string_view line = text;
+    std::optional<std::string_view> comment;
+    if (auto semi = line.find(';'); semi != line.npos) {
+      comment = line.substr(semi + 1);
+      line = line.substr(0, semi);
+    }
+    if (comment && comment->starts_with('#')) {
+      std::from_chars(comment->data() + 1, comment->data() + comment->size(),
+                      source_line);
+    }
+
+    auto first = consume_token(line, " \t\r\n,");
+    if (!first) {
+      continue;
+    }
+    if (first->ends_with(':')) {
+      if (!writer->add_label(first->substr(0, first->size() - 1))) {
+        std::cerr << "Malformed label: " << *first << std::endl;
+        return false;
+      }
+      continue;
+    }
+
+    auto op = parse_ir_op(*first);
+    if (!op) {
+      std::cerr << "Unrecognised opcode: " << *first << std::endl;
+      return false;
+    }
+    writer->add_op(*op);
+    int nargs = 0;
+    while (auto operand = consume_token(line, " \t\r\n,")) {
+      if (++nargs > 3) {
+        std::cerr << "Too many operands: " << text << std::endl;
+        return false;
+      }
+      if (operand->find_first_of(".eE") != operand->npos &&
+          !operand->starts_with('@')) {
+        double value = 0;
+        std::from_chars(operand->data(), operand->data() + operand->size(),
+                        value);
+        writer->add_arg(value);
+      } else {
+        writer->add_arg(*operand);
+      }
+    }
+    if (!writer->end_line(source_line)) {
+      std::cerr << "Misplaced " << *first << ": " << text << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ir_binary_to_text(const char *in_file, std::ostream &out) {
+  IRBinaryReader reader(in_file);
+  if (!reader.valid()) {
+    return false;
+  }
+  return reader.write_text(out);
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ir_builder.h"
+#include "ir_instr.h"
+
+/* Binary IR container (.irb), all integers little endian
+ *
+ *  header     magic "\x7fIRB", u16 version, u16 reserved,
+ *             u32 strtab offset, u32 strtab count,
+ *             u32 globals offset, u32 globals size,
+ *             u32 proc count, u32 proc table offset
+ *  proc table per proc: u32 name (strtab index), u32 offset, u32 size,
+ *             u32 size of the globals segment written before the proc
+ *  strtab     per string: varint length, bytes; global names in order of
+ *             first appearance so that the builder numbers them the same
+ *             way the text parser does
+ *  globals    records outside of any proc (GLOBAL, GLOBALARR)
+ *  procs      records from PROC up to and including ENDP
+ *
+ * record: u8 opcode | (nargs << 6), zigzag varint source line delta,
+ *         nargs operands. A label is a LABEL record with one operand.
+ * operand: varint (payload << 3 | tag), a float operand is followed by the
+ *          raw 8 bytes of the double
+ */
+namespace irb {
+
+constexpr char MAGIC[4] = {'\x7f', 'I', 'R', 'B'};
+constexpr uint16_t VERSION = 1;
+constexpr size_t HEADER_SIZE = 32;
+constexpr size_t PROC_ENTRY_SIZE = 16;
+
+enum class Tag : uint8_t { VAR, GLOBAL, LABEL, INT, FLOAT };
+
+} // namespace irb
+
+class IRBinaryWriter {
+public:
+  /* One line at a time, mirroring the textual format. These return false,
+   * writing nothing, for what a record can't hold: a fourth operand, an
+   * empty one or a label not of the form LN, or for a PROC inside a proc,
+   * one without a name or an ENDP outside of one. */
+  void add_op(IROp op);
+  /* operand in textual form: %N, @name, LN or a number */
+  bool add_arg(std::string_view operand);
+  bool add_arg(int64_t imd);
+  bool add_arg(double imd);
+  bool add_label(std::string_view label);
+  bool end_line(int source_line);
+
+  std::string finish();
+  bool write(const char *file);
+
+private:
+  struct Stream {
+    std::string data;
+    int last_line = 0;
+  };
+
+  uint32_t intern(std::string_view name);
+  Stream &stream();
+
+  std::vector<std::string> strings_;
+  std::unordered_map<std::string, uint32_t> string_ids_;
+
+  struct Proc {
+    uint32_t name;
+    uint32_t globals_before;
+    Stream stream;
+  };
+
+  Stream globals_;
+  std::vector<Proc> procs_;
+  bool in_proc_ = false;
+
+  IROp op_;
+  int nargs_ = 0;
+  std::string args_;
+  std::optional<uint32_t> proc_name_;
+};
+
+class IRBinaryReader {
+public:
+  IRBinaryReader(const char *file);
+  ~IRBinaryReader();
+
+  IRBinaryReader(const IRBinaryReader &) = delete;
+  IRBinaryReader &operator=(const IRBinaryReader &) = delete;
+
+  static bool is_binary(const char *file);
+
+  bool valid() { return valid_; }
+
+  size_t proc_count() { return procs_.size(); }
+  std::string_view proc_name(size_t i) { return strings_[procs_[i].name]; }
+  std::optional<size_t> find_proc(std::string_view name);
+
+  /* These return false on a malformed record: one cut short, an unknown
+   * opcode or operand tag, an operand out of range or, when replaying, a
+   * declaration or proc out of place. What was read up to there stays in
+   * the builder or the stream. */
+  /* whole program */
+  bool read(IRBuilder *builder);
+  /* registers all globals, must precede read_proc */
+  bool read_globals(IRBuilder *builder);
+  /* materialize a single proc */
+  bool read_proc(IRBuilder *builder, size_t i);
+
+  bool write_text(std::ostream &os);
+
+private:
+  struct Proc {
+    uint32_t name;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t globals_before;
+  };
+
+  bool replay(IRBuilder *builder, uint32_t offset, uint32_t size);
+  bool print(std::ostream &os, uint32_t offset, uint32_t size);
+  /* whether a string index or id can be resolved */
+  bool in_range(irb::Tag tag, uint64_t payload);
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  bool valid_ = false;
+
+  std::vector<std::string_view> strings_;
+  std::vector<Proc> procs_;
+  uint32_t globals_offset_ = 0;
+  uint32_t globals_size_ = 0;
+};
+
+/* text <-> binary, returns false on malformed input */
+bool ir_text_to_binary(std::istream &in, IRBinaryWriter *writer);
+bool ir_binary_to_text(const char *in_file, std::ostream &out);
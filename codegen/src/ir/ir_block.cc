@@ -1,14 +1,17 @@
 #include "ir_block.h"
 #include "ir_proc.h"
+#include "next_use.h"
 
 #include <algorithm>
 #include <unordered_map>
 
-IRBlock::IRBlock(IRProc *proc, int index)
-    : proc_(proc), idx_(index), label_(nullptr) {}
+IRBlock::IRBlock(IRProc *proc, int index) : IRBlock(proc, index, nullptr) {}
 IRBlock::IRBlock(IRProc *proc, int index, IRLabel *label)
-    : proc_(proc), idx_(index), label_(label) {
-  label_->set_block(this);
+    : proc_(proc), idx_(index), label_(label),
+      begin_(proc->instrs_.size()), end_(begin_) {
+  if (label_) {
+    label_->set_block(this);
+  }
 }
 
 void IRBlock::add_successor(IRBlock *block) { succ_.push_back(block); }
@@ -17,59 +20,87 @@ void IRBlock::add_predecessor(IRBlock *block) { pred_.push_back(block); }
 
 void IRBlock::add_instr(IRInstr instr) {
   assert(!sealed_);
-  instrs_.push_back(std::move(instr));
-  instrs_.back().set_block(this);
+  /* only the block being built appends */
+  assert(end_ == proc_->instrs_.size());
+  instr.set_block(this);
+  proc_->instrs_.push_back(std::move(instr));
+  end_++;
 }
 
 void IRBlock::process() {
+  find_refs();
+  /* increment usage count */
+  ref_.for_each([&](size_t i) { proc_->address(i)->var()->add_use(); });
+}
+
+void IRBlock::find_refs() {
   /* find use and def*/
-  for (auto &instr : instrs_) {
+  use_.clear();
+  def_.clear();
+  for (auto &instr : instrs()) {
     auto src_vars = instr.srcs();
     auto dest_var = instr.dest();
     for (auto &src : src_vars) {
-      if (!def_.contains(src)) {
-        use_.insert(src);
+      int i = proc_->index(src);
+      if (!def_.contains(i)) {
+        use_.insert(i);
       }
     }
     if (dest_var) {
-      if (!use_.contains(dest_var)) {
-        def_.insert(dest_var);
+      int i = proc_->index(dest_var);
+      if (!use_.contains(i)) {
+        def_.insert(i);
       }
     }
   }
   ref_.clear();
-  for (auto &addr : use_) {
-    if (addr->is_var()) {
-      ref_.insert(addr->var());
+  auto add_ref = [&](size_t i) {
+    if (proc_->address(i)->is_var()) {
+      ref_.insert(i);
     }
-  }
-  for (auto &addr : def_) {
-    if (addr->is_var()) {
-      ref_.insert(addr->var());
-    }
-  }
+  };
+  use_.for_each(add_ref);
+  def_.for_each(add_ref);
+}
 
-  /* increment usage count */
-  for (auto &var : ref_) {
-    var->add_use();
-  }
+bool IRBlock::is_live_on_exit(IRAddress *var) {
+  int i = proc_->index(var);
+  return i >= 0 && live_out_.contains(i);
 }
 
-void IRBlock::find_next_use() {
-  /* find next use info */
-  IRInstr::NextUseInfo next_use = live_out_;
+void IRBlock::find_next_use(std::vector<uint32_t> &next) {
+  /* next read of each address seen so far, walking backwards; addresses
+   * not seen yet are read next after the block if they are live on exit */
+  auto next_read = [&](int i) {
+    if (next[i] != NextUse::UNSET) {
+      return next[i];
+    }
+    return live_out_.contains(i) ? NextUse::LIVE_OUT : NextUse::DEAD;
+  };
 
   /* iterate backwards */
-  for (int i = instrs_.size() - 1; i >= 0; i--) {
-    auto &instr = instrs_[i];
-    auto src_vars = instr.srcs();
-    auto dest_var = instr.dest();
-    instr.set_next_use(next_use);
-    if (dest_var) {
-      next_use.erase(dest_var);
+  auto instrs = this->instrs();
+  for (int pos = instrs.size() - 1; pos >= 0; pos--) {
+    auto &instr = instrs[pos];
+    for (int k = 0; k < 3; k++) {
+      if (auto addr = instr.operand(k)) {
+        instr.next_use_[k] = next_read(proc_->index(addr));
+      }
     }
-    for (auto &src : src_vars) {
-      next_use.insert(src);
+    if (auto dest_var = instr.dest()) {
+      next[proc_->index(dest_var)] = NextUse::DEAD;
+    }
+    for (auto &src : instr.srcs()) {
+      next[proc_->index(src)] = pos;
+    }
+  }
+
+  /* leave it clean for the next block */
+  for (auto &instr : instrs) {
+    for (int k = 0; k < 3; k++) {
+      if (auto addr = instr.operand(k)) {
+        next[proc_->index(addr)] = NextUse::UNSET;
+      }
     }
   }
 }
@@ -79,19 +110,19 @@ void IRBlock::end_block() {
   process();
 }
 
-std::vector<IRInstr> &IRBlock::instrs() {
-  assert(!instrs_.empty());
-  return instrs_;
+std::span<IRInstr> IRBlock::instrs() {
+  return {proc_->instrs_.data() + begin_, size()};
 }
 
 IRInstr &IRBlock::last_instr() {
-  assert(!instrs_.empty());
-  return instrs_.back();
+  assert(size());
+  return proc_->instrs_[end_ - 1];
 }
 
 void IRBlock::alloc_vars() {
   int max_offset = 0;
-  for (auto &var : var_in_) {
+  var_in_.for_each([&](size_t i) {
+    auto var = proc_->address(i)->var();
     // if (!var->has_address()) {
     //   std::cout << "undef var: %" << var->id() << std::endl;
     //   std::cout << "in block #" << index() << std::endl
@@ -111,35 +142,36 @@ void IRBlock::alloc_vars() {
     // }
     assert(var->has_address());
     max_offset = std::max(max_offset, var->offset());
-  }
+  });
 
-  /* to be allocated */
+  /* to be allocated, in order of first appearance */
   std::vector<IRVar *> vars;
-  for (auto &var : first_def_) {
+  first_def_.for_each([&](size_t i) {
+    auto var = proc_->address(i)->var();
     /* params could already have address assigned */
     if (!var->has_address()) {
       vars.push_back(var);
       // default size
       var->set_size(1);
     }
-  }
+  });
 
-  for (auto &instr : instrs_) {
+  for (auto &instr : instrs()) {
     /* set variable sizes */
     switch (instr.op()) {
     case IROp::AALLOC:
-      assert(first_def_.contains(instr.arg1().var()));
+      assert(first_def_.contains(proc_->index(instr.arg1().var())));
       instr.arg1().var()->set_size(instr.arg2().imd_int());
       break;
     case IROp::ALLOC:
-      assert(first_def_.contains(instr.arg1().var()));
+      assert(first_def_.contains(proc_->index(instr.arg1().var())));
     default:
       break;
     }
   }
 
   /* allocate more used vars lower on the stack */
-  std::sort(vars.begin(), vars.end(), [](const IRVar *a, const IRVar *b) {
+  std::stable_sort(vars.begin(), vars.end(), [](const IRVar *a, const IRVar *b) {
     return a->use_count() > b->use_count();
   });
 
@@ -1,13 +1,26 @@
 #pragma once
 
+#include "bit_set.h"
 #include "ir_instr.h"
 
-#include <set>
+#include <span>
 
 class IRProc;
 
+/* phi function of SSA form, see SSA */
+struct IRPhi {
+  /* the var it merges versions of */
+  IRVar *var;
+  IRVar *dest;
+  /* the version coming in from each predecessor, in their order */
+  std::vector<IRArg> args;
+};
+
 class IRBlock {
   friend class IRProc;
+  friend class SSA;
+  friend class SCCP;
+  friend class DCE;
 
 public:
   IRBlock(IRProc *proc, int idx);
@@ -15,26 +28,36 @@ public:
 
   void add_successor(IRBlock *block);
   void add_predecessor(IRBlock *block);
+  const std::vector<IRBlock *> &successors() { return succ_; }
+  const std::vector<IRBlock *> &predecessors() { return pred_; }
   void add_instr(IRInstr instr);
   void alloc_vars();
 
   /* find next use, use, def information */
   void process();
-  /* find next use, needs entire proc to be processed first */
-  void find_next_use();
+  /* find use, def and ref again after the instructions changed */
+  void find_refs();
+  /* find next use of every operand, needs entire proc to be processed
+   * first. next is scratch space by IRProc::index, all NextUse::UNSET,
+   * and left that way. */
+  void find_next_use(std::vector<uint32_t> &next);
   /* seal and call process */
   void end_block();
   /* might be null */
   IRLabel *label() { return label_; }
 
-  const std::set<IRAddress *> &live_on_exit() { return live_out_; }
-  bool is_live_on_exit(IRAddress *var) { return live_out_.contains(var); }
+  /* by IRProc::index */
+  const BitSet &live_on_exit() { return live_out_; }
+  bool is_live_on_exit(IRAddress *var);
 
-  size_t size() { return instrs_.size(); }
+  size_t size() { return end_ - begin_; }
 
-  std::vector<IRInstr> &instrs();
+  std::span<IRInstr> instrs();
   IRInstr &last_instr();
 
+  /* only while the proc is in SSA form */
+  std::vector<IRPhi> &phis() { return phis_; }
+
   int stack_offset() { return stack_offset_; }
 
   IRProc *proc() { return proc_; }
@@ -47,17 +70,27 @@ private:
   IRLabel *label_;
   /* successors and predecessors in flow graph */
   std::vector<IRBlock *> succ_, pred_;
-  std::set<IRAddress *> use_, def_;
+  /* address sets, by IRProc::index */
+  BitSet use_, def_;
   /* ref = (use ∪ def) ∩ var */
-  std::set<IRVar *> ref_;
+  BitSet ref_;
   /* live w.r.t value usage */
-  std::set<IRAddress *> live_in_, live_out_;
+  BitSet live_in_, live_out_;
   /* live w.r.t variable name */
-  std::set<IRVar *> var_in_, var_out_;
+  BitSet var_in_, var_out_;
   /* variables first defined here */
-  std::set<IRVar *> first_def_;
+  BitSet first_def_;
+  /* ref - first_def, what var liveness adds to the block's IN */
+  BitSet var_gen_;
+
+  std::vector<IRPhi> phis_;
+
+  /* position in the dataflow solver's order */
+  size_t rank_ = 0;
 
-  std::vector<IRInstr> instrs_;
+  /* range of the proc's instructions, which are stored contiguously in
+   * block order */
+  uint32_t begin_, end_;
   bool sealed_ = false;
   int idx_;
   int stack_offset_;
@@ -0,0 +1,156 @@
+#include "ir_builder.h"
+
+#include <charconv>
+
+IRLabel *IRBuilder::get_label(size_t id) {
+  if (id >= DENSE_IDS) {
+    return &program_.far_labels_.try_emplace(id, (int)id).first->second;
+  }
+  auto &labels = program_.labels_;
+  while (labels.size() <= id) {
+    labels.emplace_back(labels.size());
+  }
+  return &labels[id];
+}
+
+IRVar *IRBuilder::get_var(size_t id) {
+  if (id >= DENSE_IDS) {
+    auto [itr, inserted] = far_vars_.try_emplace(id, nullptr);
+    if (inserted) {
+      itr->second = &program_.vars_.emplace_back((int)id);
+    }
+    return itr->second;
+  }
+  if (id >= proc_vars_.size()) {
+    proc_vars_.resize(id + 1);
+  }
+  auto &slot = proc_vars_[id];
+  if (!slot.var || slot.proc != proc_number_) {
+    slot = {&program_.vars_.emplace_back((int)id), proc_number_};
+  }
+  return slot.var;
+}
+
+IRGlobal *IRBuilder::get_global(std::string name) {
+  static const std::set<std::string> built_ins = {"main", "println"};
+  auto [itr, inserted] = program_.global_names_.try_emplace(name, nullptr);
+  if (inserted) {
+    int id = program_.globals_.size();
+    if (!built_ins.contains(name)) {
+      program_.globals_.emplace_back(name + std::to_string(id), id);
+    } else {
+      // don't do anything for built-in func
+      program_.globals_.emplace_back(name, id);
+    }
+    itr->second = &program_.globals_.back();
+  }
+  return itr->second;
+}
+
+IRArg IRBuilder::arg(std::string_view operand) {
+  assert(!operand.empty());
+  auto number = [&](size_t skip, auto value) {
+    std::from_chars(operand.data() + skip, operand.data() + operand.size(),
+                    value);
+    return value;
+  };
+  switch (operand[0]) {
+  case '%':
+    return IRArg(get_var(number(1, size_t(0))));
+  case '@':
+    return IRArg(get_global(std::string(operand.substr(1))));
+  case 'L':
+    return IRArg(get_label(number(1, size_t(0))));
+  default:
+    return IRArg(number(0, 0));
+  }
+}
+
+void IRBuilder::new_line() {
+
+  if (current_line_.empty()) {
+    return;
+  }
+
+  if (current_line_[0].is_opcode()) {
+    /* not a label */
+    last_label_ = std::nullopt;
+
+    auto opcode = current_line_[0].opcode();
+    /* global declarations are special cases */
+    switch (opcode) {
+    case IROp::GLOBAL: {
+      assert(current_line_.size() == 2);
+      auto global = current_line_[1].arg().global();
+      global->set_size(1);
+    } break;
+    case IROp::GLOBALARR: {
+      assert(current_line_.size() == 3);
+      auto global = current_line_[1].arg().global();
+      auto size = current_line_[2].arg().imd_int();
+      global->set_size(size);
+    } break;
+    case IROp::PROC: {
+      assert(current_line_.size() == 2);
+      auto global = current_line_[1].arg().global();
+      new_proc(global);
+    } break;
+    case IROp::ENDP: {
+      end_proc();
+    } break;
+    default:
+      /* otherwise just add instruction to current proc */
+      if (current_line_.size() == 1) {
+        add_instr(IRInstr(opcode));
+      } else if (current_line_.size() == 2) {
+        add_instr(IRInstr(opcode, current_line_[1].arg()));
+      } else if (current_line_.size() == 3) {
+        add_instr(
+            IRInstr(opcode, current_line_[1].arg(), current_line_[2].arg()));
+      } else if (current_line_.size() == 4) {
+        add_instr(IRInstr(opcode, current_line_[1].arg(),
+                          current_line_[2].arg(), current_line_[3].arg()));
+      }
+      break;
+    }
+  } else {
+    /* must be a label */
+    add_label(current_line_[0].arg().label());
+  }
+
+  current_line_.clear();
+}
+
+void IRBuilder::new_proc(IRGlobal *global) {
+  proc_number_++;
+  far_vars_.clear();
+  current_proc_ = std::make_unique<IRProc>(std::string(global->name()));
+}
+
+void IRBuilder::end_proc() {
+  assert(current_proc_);
+  current_proc_->end_proc();
+  program_.procs_.push_back(std::move(current_proc_));
+  current_proc_ = nullptr;
+}
+
+void IRBuilder::add_instr(IRInstr instr) {
+  instr.set_source_line(current_source_line_);
+  assert(current_proc_);
+  current_proc_->add_instr(std::move(instr));
+}
+
+void IRBuilder::add_label(IRLabel *label) {
+  if (!last_label_) {
+    assert(current_proc_);
+    current_proc_->add_label(label);
+    last_label_ = label;
+  } else {
+    /* two consecutive labels */
+    (*last_label_)->merge(label);
+  }
+}
+
+void IRBuilder::add_token(IRToken token) {
+  current_line_.push_back(std::move(token));
+}
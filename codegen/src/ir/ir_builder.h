@@ -0,0 +1,62 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ir/ir_proc.h"
+#include "ir_instr.h"
+#include "ir_program.h"
+#include "ir_token.h"
+
+/* builds an IRProgram line by line, shared by the text parser and the
+ * in-memory IR generator */
+class IRBuilder {
+public:
+  IRLabel *get_label(size_t id);
+  /* %id of the proc being built; every proc gets vars of its own, even for
+   * an id another proc uses too, as code generation writes to them */
+  IRVar *get_var(size_t id);
+  IRGlobal *get_global(std::string name);
+
+  /* resolve an operand in its textual form (%N, @name, LN) */
+  IRArg arg(std::string_view operand);
+
+  void new_line();
+  void new_proc(IRGlobal *global);
+  void end_proc();
+  void add_token(IRToken token);
+  void add_instr(IRInstr instr);
+
+  void add_label(IRLabel *label);
+
+  IRProgram *program() { return &program_; }
+
+  void source_line(int line) { current_source_line_ = line; }
+  int souce_line() { return current_source_line_; }
+
+protected:
+  std::vector<IRToken> current_line_;
+  std::unique_ptr<IRProc> current_proc_;
+
+  IRProgram program_;
+  std::optional<IRLabel *> last_label_;
+  /* Ids are dense in practice, so they index vectors; one far beyond
+   * this, which only a malformed .ir has, goes to a map instead of making
+   * the vector that large. */
+  static constexpr size_t DENSE_IDS = 1 << 20;
+
+  /* Vars by id, each with the number of the proc it was made for. Those
+   * of earlier procs are stale, so starting a proc is just counting it. */
+  struct ProcVar {
+    IRVar *var = nullptr;
+    size_t proc = 0;
+  };
+  std::vector<ProcVar> proc_vars_;
+  std::unordered_map<size_t, IRVar *> far_vars_;
+  size_t proc_number_ = 0;
+
+  int current_source_line_ = 0;
+};
@@ -6,17 +6,88 @@
 #include "ast/stmt.h"
 #include "ast/type.h"
 
+#include "thread_pool.h"
+
+#include <charconv>
 #include <fstream>
 
 using std::nullopt;
 
+IROperand IROperand::parse(std::string_view operand) {
+  assert(!operand.empty());
+  IROperand a;
+  auto number = [&](size_t skip) {
+    int64_t value = 0;
+    std::from_chars(operand.data() + skip, operand.data() + operand.size(),
+                    value);
+    return value;
+  };
+  switch (operand[0]) {
+  case '%':
+    a.kind = Kind::VAR;
+    a.number = number(1);
+    break;
+  case '@':
+    a.kind = Kind::GLOBAL;
+    a.global = Interner::intern(operand.substr(1));
+    break;
+  case 'L':
+    a.kind = Kind::LABEL;
+    a.number = number(1);
+    break;
+  default:
+    a.kind = Kind::INT;
+    a.number = number(0);
+    break;
+  }
+  return a;
+}
+
+std::ostream &operator<<(std::ostream &os, const IROperand &a) {
+  switch (a.kind) {
+  case IROperand::Kind::VAR:
+    return os << "%" << a.number;
+  case IROperand::Kind::LABEL:
+    return os << "L" << a.number;
+  case IROperand::Kind::GLOBAL:
+    return os << "@" << a.global.str();
+  case IROperand::Kind::INT:
+    return os << a.number;
+  case IROperand::Kind::FLOAT:
+    return os << a.imd_float;
+  }
+  return os;
+}
+
+IRGenerator::IRGenerator() : recording_(true) {
+  context_stack_.push(IRGenContext(true));
+}
+
 IRGenerator::IRGenerator(const char *file) : out_file_(file) {
   context_stack_.push(IRGenContext(true));
 }
 
-void IRGenerator::generate(ASTNode *node) {
+IRGenerator::IRGenerator(IRBuilder *builder, const char *file)
+    : builder_(builder) {
+  if (file) {
+    out_file_.open(file);
+  }
+  context_stack_.push(IRGenContext(true));
+}
+
+IRGenerator::IRGenerator(IRBinaryWriter *writer) : writer_(writer) {
+  context_stack_.push(IRGenContext(true));
+}
+
+void IRGenerator::generate(ASTNode *node, int jobs) {
+  jobs_ = jobs;
   node->visit(this);
-  out_file_.close();
+  if (out_file_.is_open()) {
+    out_file_.close();
+  }
+  if (builder_) {
+    builder_->new_line();
+  }
 }
 
 VarOrImmediate::VarOrImmediate(std::string var) : data_(std::move(var)) {}
@@ -289,8 +360,34 @@ void IRGenerator::visit_var_decl(VarDecl *var_decl) {
 }
 
 void IRGenerator::visit_translation_unit_decl(TranslationUnitDecl *trans_decl) {
-  for (auto &unit : trans_decl->decl_units()) {
-    unit->visit(this);
+  auto &units = trans_decl->decl_units();
+  if (jobs_ <= 1) {
+    for (auto &unit : units) {
+      unit->visit(this);
+    }
+    return;
+  }
+
+  struct Unit {
+    std::vector<IRLine> lines;
+    int temps, labels;
+  };
+  std::vector<Unit> done(units.size());
+  ThreadPool pool(jobs_);
+  pool.run(units.size(), [&](size_t i) {
+    IRGenerator gen;
+    units[i]->visit(&gen);
+    done[i] = {std::move(gen.lines_), gen.current_temp_ - 1,
+               gen.current_label_};
+  });
+
+  /* numbered as if each unit had carried on from the previous one */
+  for (auto &unit : done) {
+    for (auto &line : unit.lines) {
+      write_line(line, current_temp_ - 1, current_label_);
+    }
+    current_temp_ += unit.temps;
+    current_label_ += unit.labels;
   }
 }
 
@@ -781,7 +878,7 @@ void IRGenerator::visit_float_literal(FloatLiteral *float_literal) {
 }
 
 void IRGenerator::print_ir_label(std::string &label) {
-  out_file_ << label << ": " << std::endl;
+  emit(IRLine{IROp::LABEL, 1, {IROperand::parse(label)}, 0});
 }
 
 std::string IRGenerator::new_label() {
@@ -800,12 +897,106 @@ void IRGenerator::print_tab(IROp op) {
   }
 }
 
-void IRGenerator::print_src_loc(ASTNode *node) {
-  out_file_ << ";#" << node->location().start_line() << std::endl;
+void IRGenerator::print_ir_instr(IROp op, ASTNode *n) { emit(op, {}, n); }
+
+void IRGenerator::emit(IROp op, std::initializer_list<IROperand> args,
+                       ASTNode *n) {
+  IRLine line{op, uint8_t(args.size()), {}, n->location().start_line()};
+  std::copy(args.begin(), args.end(), line.args);
+  emit(line);
 }
 
-void IRGenerator::print_ir_instr(IROp op, ASTNode *n) {
-  print_tab(op);
-  out_file_ << to_string(op);
-  print_src_loc(n);
+void IRGenerator::emit(const IRLine &line) {
+  if (recording_) {
+    lines_.push_back(line);
+  } else {
+    write_line(line, 0, 0);
+  }
+}
+
+void IRGenerator::write_line(const IRLine &line, int var_base,
+                             int label_base) {
+  IROperand args[3];
+  for (int i = 0; i < line.nargs; i++) {
+    args[i] = line.args[i];
+    if (args[i].kind == IROperand::Kind::VAR) {
+      args[i].number += var_base;
+    } else if (args[i].kind == IROperand::Kind::LABEL) {
+      args[i].number += label_base;
+    }
+  }
+
+  if (line.op == IROp::LABEL) {
+    if (out_file_.is_open()) {
+      out_file_ << args[0] << ": \n";
+    }
+    if (builder_) {
+      builder_->add_token(IRArg(builder_->get_label(args[0].number)));
+      builder_->new_line();
+    }
+    if (writer_) {
+      writer_->add_label("L" + std::to_string(args[0].number));
+    }
+    return;
+  }
+
+  if (out_file_.is_open()) {
+    print_tab(line.op);
+    out_file_ << to_string(line.op);
+    for (int i = 0; i < line.nargs; i++) {
+      out_file_ << (i ? ", " : " ") << args[i];
+    }
+    out_file_ << ";#" << line.source_line << "\n";
+  }
+  if (builder_) {
+    /* same token sequence the IR scanner would produce for the text form */
+    builder_->add_token(IRToken(line.op));
+    for (int i = 0; i < line.nargs; i++) {
+      auto &a = args[i];
+      switch (a.kind) {
+      case IROperand::Kind::VAR:
+        builder_->add_token(IRArg(builder_->get_var(a.number)));
+        break;
+      case IROperand::Kind::LABEL:
+        builder_->add_token(IRArg(builder_->get_label(a.number)));
+        break;
+      case IROperand::Kind::GLOBAL:
+        builder_->add_token(
+            IRArg(builder_->get_global(std::string(a.global.str()))));
+        break;
+      case IROperand::Kind::INT:
+        builder_->add_token(IRArg(int(a.number)));
+        break;
+      case IROperand::Kind::FLOAT:
+        builder_->add_token(IRArg(a.imd_float));
+        break;
+      }
+    }
+    builder_->source_line(line.source_line);
+    builder_->new_line();
+  }
+  if (writer_) {
+    writer_->add_op(line.op);
+    for (int i = 0; i < line.nargs; i++) {
+      auto &a = args[i];
+      switch (a.kind) {
+      case IROperand::Kind::INT:
+        writer_->add_arg(a.number);
+        break;
+      case IROperand::Kind::FLOAT:
+        writer_->add_arg(a.imd_float);
+        break;
+      case IROperand::Kind::VAR:
+        writer_->add_arg("%" + std::to_string(a.number));
+        break;
+      case IROperand::Kind::LABEL:
+        writer_->add_arg("L" + std::to_string(a.number));
+        break;
+      case IROperand::Kind::GLOBAL:
+        writer_->add_arg("@" + std::string(a.global.str()));
+        break;
+      }
+    }
+    writer_->end_line(line.source_line);
+  }
 }
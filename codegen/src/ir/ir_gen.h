@@ -1,12 +1,41 @@
 #include <stack>
+#include <variant>
 
 #include "ast/ast_node.h"
 #include "ast/ast_visitor.h"
+#include "ir_binary.h"
+#include "ir_builder.h"
 #include "ir_instr.h"
 
 #include <fstream>
 
 class Expr;
+
+/* operand of a generated line; vars and labels by number */
+struct IROperand {
+  enum class Kind : uint8_t { VAR, LABEL, GLOBAL, INT, FLOAT };
+
+  /* from the textual form: %N, @name, LN or a number */
+  static IROperand parse(std::string_view operand);
+
+  Kind kind;
+  union {
+    int64_t number;
+    double imd_float;
+  };
+  Name global;
+
+  friend std::ostream &operator<<(std::ostream &os, const IROperand &a);
+};
+
+/* one line of IR, a label is a LABEL line with the label as operand */
+struct IRLine {
+  IROp op;
+  uint8_t nargs;
+  IROperand args[3];
+  int source_line;
+};
+
 struct IRGenContext {
   const bool global_scope;
   IRGenContext(bool global = false) : global_scope(global) {}
@@ -41,7 +70,15 @@ private:
 class IRGenerator : public ASTVisitor {
 public:
   IRGenerator(const char *file);
-  void generate(ASTNode *node);
+  /* emit straight into builder, optionally also dumping text to file */
+  IRGenerator(IRBuilder *builder, const char *file = nullptr);
+  /* emit binary IR, see ir_binary.h */
+  IRGenerator(IRBinaryWriter *writer);
+  /* With jobs > 1 the top level declarations are generated concurrently,
+   * each numbering its temps and labels from zero, and written out in
+   * order with the numbers shifted to where a serial run would have put
+   * them. The output doesn't depend on jobs. */
+  void generate(ASTNode *node, int jobs = 1);
 
   void visit_node(ASTNode *node) {}
 
@@ -83,16 +120,25 @@ public:
   }
 
 private:
+  /* only records lines, for generating a declaration on a worker */
+  IRGenerator();
+
   IRGenContext &context() { return context_stack_.top(); }
 
   void print_tab(IROp op);
-  void print_src_loc(ASTNode *node);
   void print_ir_instr(IROp op, ASTNode *n);
   void print_ir_instr(IROp op, auto &&a1, ASTNode *n);
   void print_ir_instr(IROp op, auto &&a1, auto &&a2, ASTNode *n);
   void print_ir_instr(IROp op, auto &&a1, auto &&a2, auto &&a3, ASTNode *n);
   void print_ir_label(std::string &label);
 
+  IROperand to_operand(auto &&a);
+  void emit(IROp op, std::initializer_list<IROperand> args, ASTNode *n);
+  void emit(const IRLine &line);
+  /* write line to the text file, builder and writer, vars and labels
+   * shifted by the given amounts */
+  void write_line(const IRLine &line, int var_base, int label_base);
+
   std::string new_label();
 
   void gen_conditional_jump(ASTNode *n);
@@ -110,6 +156,12 @@ private:
   std::string next_label_;
 
   std::ofstream out_file_;
+  IRBuilder *builder_ = nullptr;
+  IRBinaryWriter *writer_ = nullptr;
+  /* lines_ collects the output instead */
+  bool recording_ = false;
+  std::vector<IRLine> lines_;
+  int jobs_ = 1;
 
   std::stack<IRGenContext> context_stack_;
 
@@ -117,21 +169,38 @@ private:
   std::optional<std::string> exit_label_;
 };
 
+IROperand IRGenerator::to_operand(auto &&a) {
+  using T = std::decay_t<decltype(a)>;
+  IROperand operand;
+  if constexpr (std::is_same_v<T, VarOrImmediate>) {
+    VarOrImmediate v = a;
+    if (v.is_imd_int()) {
+      return to_operand(v.int_imd());
+    } else if (v.is_imd_float()) {
+      return to_operand(v.float_imd());
+    }
+    return IROperand::parse(v.str());
+  } else if constexpr (std::is_floating_point_v<T>) {
+    operand.kind = IROperand::Kind::FLOAT;
+    operand.imd_float = a;
+  } else if constexpr (std::is_integral_v<T>) {
+    operand.kind = IROperand::Kind::INT;
+    operand.number = a;
+  } else {
+    return IROperand::parse(a);
+  }
+  return operand;
+}
+
 void IRGenerator::print_ir_instr(IROp op, auto &&a1, ASTNode *n) {
-  print_tab(op);
-  out_file_ << to_string(op) << " " << a1;
-  print_src_loc(n);
+  emit(op, {to_operand(a1)}, n);
 }
 
 void IRGenerator::print_ir_instr(IROp op, auto &&a1, auto &&a2, ASTNode *n) {
-  print_tab(op);
-  out_file_ << to_string(op) << " " << a1 << ", " << a2;
-  print_src_loc(n);
+  emit(op, {to_operand(a1), to_operand(a2)}, n);
 }
 
 void IRGenerator::print_ir_instr(IROp op, auto &&a1, auto &&a2, auto &&a3,
                                  ASTNode *n) {
-  print_tab(op);
-  out_file_ << to_string(op) << " " << a1 << ", " << a2 << ", " << a3;
-  print_src_loc(n);
+  emit(op, {to_operand(a1), to_operand(a2), to_operand(a3)}, n);
 }
@@ -96,40 +96,37 @@ std::string_view to_string(IROp op) {
   return "";
 }
 
-IRArg::IRArg(IRLabel *label) : data_(label) { type_ = IRArgType::LABEL; }
-IRArg::IRArg(IRVar *var) : data_(var) { type_ = IRArgType::VARIABLE; }
-IRArg::IRArg(IRGlobal *global) : data_(global) { type_ = IRArgType::GLOBAL; }
-IRArg::IRArg(int imd) : data_(imd) { type_ = IRArgType::IMD_INT; }
-IRArg::IRArg(double imd) : data_(imd) { type_ = IRArgType::IMD_FLOAT; }
-
-bool IRArg::is_label() { return std::holds_alternative<IRLabel *>(data_); }
-bool IRArg::is_global() { return std::holds_alternative<IRGlobal *>(data_); }
-bool IRArg::is_var() { return std::holds_alternative<IRVar *>(data_); }
-bool IRArg::is_imd_int() { return std::holds_alternative<int>(data_); }
-bool IRArg::is_imd_float() { return std::holds_alternative<double>(data_); }
+std::optional<IROp> parse_ir_op(std::string_view str) {
+  for (int i = 0; i <= (int)IROp::ADDR; i++) {
+    if (to_string(IROp(i)) == str) {
+      return IROp(i);
+    }
+  }
+  return std::nullopt;
+}
 
-IRLabel *IRArg::label() {
+IRLabel *IRArg::label() const {
   assert(is_label());
-  return std::get<IRLabel *>(data_);
+  return label_;
 }
-IRVar *IRArg::var() {
+IRVar *IRArg::var() const {
   assert(is_var());
-  return std::get<IRVar *>(data_);
+  return var_;
 }
-IRGlobal *IRArg::global() {
+IRGlobal *IRArg::global() const {
   assert(is_global());
-  return std::get<IRGlobal *>(data_);
+  return global_;
 }
-int64_t IRArg::imd_int() {
+int64_t IRArg::imd_int() const {
   assert(is_imd_int());
-  return std::get<int>(data_);
+  return int_;
 }
-double IRArg::imd_float() {
+double IRArg::imd_float() const {
   assert(is_imd_float());
-  return std::get<double>(data_);
+  return float_;
 }
 
-IRAddress *IRArg::addr() {
+IRAddress *IRArg::addr() const {
   assert(is_addr());
   if (is_var()) {
     return var();
@@ -138,76 +135,62 @@ IRAddress *IRArg::addr() {
   }
 }
 
-IRInstr::IRInstr(IROp op) : op_(op) {
-  src_vars_ = find_srcs();
-  dest_var_ = find_dest();
-}
+IRInstr::IRInstr(IROp op) : op_(op), nargs_(0) {}
 
-IRInstr::IRInstr(IROp op, IRArg arg1) : op_(op), arg1_(arg1) {
-  src_vars_ = find_srcs();
-  dest_var_ = find_dest();
-  arg1_->set_instr(this);
-}
+IRInstr::IRInstr(IROp op, IRArg arg1) : op_(op), nargs_(1), args_{arg1} {}
 
 IRInstr::IRInstr(IROp op, IRArg arg1, IRArg arg2)
-    : op_(op), arg1_(arg1), arg2_(arg2) {
-  src_vars_ = find_srcs();
-  dest_var_ = find_dest();
-  arg1_->set_instr(this);
-  arg2_->set_instr(this);
-}
+    : op_(op), nargs_(2), args_{arg1, arg2} {}
 
 IRInstr::IRInstr(IROp op, IRArg arg1, IRArg arg2, IRArg arg3)
-    : op_(op), arg1_(arg1), arg2_(arg2), arg3_(arg3) {
-  src_vars_ = find_srcs();
-  dest_var_ = find_dest();
-  arg1_->set_instr(this);
-  arg2_->set_instr(this);
-  arg3_->set_instr(this);
-}
+    : op_(op), nargs_(3), args_{arg1, arg2, arg3} {}
 
 IRArg IRInstr::arg1() const {
-  assert(arg1_);
-  return arg1_.value();
+  assert(has_arg1());
+  return args_[0];
 }
 
 IRArg IRInstr::arg2() const {
-  assert(arg2_);
-  return arg2_.value();
+  assert(has_arg2());
+  return args_[1];
 }
 
 IRArg IRInstr::arg3() const {
-  assert(arg3_);
-  return arg3_.value();
+  assert(has_arg3());
+  return args_[2];
 }
 
-std::set<IRAddress *> IRInstr::find_srcs() {
-  std::set<IRAddress *> ret;
-  std::vector<IRArg> src;
+IROperands IRInstr::srcs() const {
+  IROperands ret;
+  auto add = [&](int i) {
+    if (auto addr = operand(i)) {
+      ret.push_back(addr);
+    }
+  };
   switch (op()) {
   case IROp::PTRST:
-    src.push_back(arg1());
-    src.push_back(arg2());
-    src.push_back(arg3());
+    add(0);
+    add(1);
+    add(2);
     break;
   case IROp::PTRLD:
-    src.push_back(arg2());
-    src.push_back(arg3());
+    add(1);
+    add(2);
     break;
   case IROp::COPY:
-    src.push_back(arg2());
+    add(1);
     break;
   case IROp::INC:
   case IROp::DEC:
   case IROp::NOT:
   case IROp::NEG:
-    src.push_back(arg2());
+    add(1);
     break;
   case IROp::JMPIF:
-    src.push_back(arg1());
+    add(0);
     break;
   case IROp::JMPIFNOT:
-    src.push_back(arg1());
+    add(0);
     break;
   case IROp::JMP:
     break;
@@ -218,37 +201,29 @@ std::set<IRAddress *> IRInstr::find_srcs() {
   case IROp::GLOBALARR:
     break;
   case IROp::PARAM:
-    src.push_back(arg1());
+    add(0);
     break;
   case IROp::CALL:
   case IROp::PROC:
   case IROp::ENDP:
     break;
   case IROp::RET:
-    if (arg1_) {
-      src.push_back(arg1());
-    }
+    add(0);
     break;
   case IROp::LABEL:
     break;
   case IROp::ADDR:
-    src.push_back(arg2());
+    add(1);
     break;
   default:
-    src.push_back(arg2());
-    src.push_back(arg3());
+    add(1);
+    add(2);
     break;
   }
-
-  for (auto &arg : src) {
-    if (arg.is_addr()) {
-      ret.insert(arg.addr());
-    }
-  }
   return ret;
 }
 
-IRAddress *IRInstr::find_dest() {
+IRAddress *IRInstr::dest() const {
   switch (op_) {
   case IROp::PTRLD:
   case IROp::COPY:
@@ -305,14 +280,8 @@ std::ostream &operator<<(std::ostream &os, IRArg arg) {
 
 std::ostream &operator<<(std::ostream &os, const IRInstr &instr) {
   os << to_string(instr.op());
-  if (instr.arg1_) {
-    os << " " << *instr.arg1_;
-  }
-  if (instr.arg2_) {
-    os << ", " << *instr.arg2_;
-  }
-  if (instr.arg3_) {
-    os << ", " << *instr.arg3_;
+  for (int i = 0; i < instr.nargs_; i++) {
+    os << (i ? ", " : " ") << instr.args_[i];
   }
   return os;
 }
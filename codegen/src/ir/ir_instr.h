@@ -1,17 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <optional>
-#include <set>
 #include <string>
-#include <unordered_set>
-#include <variant>
+#include <type_traits>
 #include <vector>
 
 #include "ir_address.h"
 
-enum class IROp {
+enum class IROp : uint8_t {
   PTRST,
   PTRLD,
   COPY,
@@ -54,6 +55,7 @@ enum class IROp {
 
 bool is_jump(IROp op);
 std::string_view to_string(IROp op);
+std::optional<IROp> parse_ir_op(std::string_view str);
 
 class IRInstr;
 class IRBlock;
@@ -64,6 +66,7 @@ class IRLabel {
 public:
   IRLabel(int id) : id_(id) {}
   IRBlock *block() { return block_; }
+  int id() const { return id_; }
   std::string name() { return "L" + std::to_string(id_); }
 
   void merge(IRLabel *other);
@@ -75,49 +78,75 @@ private:
   IRBlock *block_ = nullptr;
 };
 
-enum class IRArgType { VARIABLE, IMD_INT, IMD_FLOAT, LABEL, GLOBAL };
+enum class IRArgType : uint8_t { VARIABLE, IMD_INT, IMD_FLOAT, LABEL, GLOBAL };
 
+/* operand, a tagged union; vars, labels and globals are owned by the
+ * IRProgram */
 class IRArg {
 
 public:
-  IRArg(IRLabel *label);
-  IRArg(IRVar *var);
-  IRArg(IRGlobal *global);
-  IRArg(int imd);
-  IRArg(double imd);
-
-  bool is_label();
-  bool is_global();
-  bool is_var();
-  bool is_imd_int();
-  bool is_imd_float();
-  bool is_addr() { return is_var() || is_global(); }
-
-  IRLabel *label();
-  IRVar *var();
-  IRGlobal *global();
-  IRAddress *addr();
-  int64_t imd_int();
-  double imd_float();
+  IRArg() : IRArg(0) {}
+  IRArg(IRLabel *label) : type_(IRArgType::LABEL), label_(label) {}
+  IRArg(IRVar *var) : type_(IRArgType::VARIABLE), var_(var) {}
+  IRArg(IRGlobal *global) : type_(IRArgType::GLOBAL), global_(global) {}
+  IRArg(int imd) : type_(IRArgType::IMD_INT), int_(imd) {}
+  IRArg(double imd) : type_(IRArgType::IMD_FLOAT), float_(imd) {}
+
+  bool is_label() const { return type_ == IRArgType::LABEL; }
+  bool is_global() const { return type_ == IRArgType::GLOBAL; }
+  bool is_var() const { return type_ == IRArgType::VARIABLE; }
+  bool is_imd_int() const { return type_ == IRArgType::IMD_INT; }
+  bool is_imd_float() const { return type_ == IRArgType::IMD_FLOAT; }
+  bool is_addr() const { return is_var() || is_global(); }
+
+  IRLabel *label() const;
+  IRVar *var() const;
+  IRGlobal *global() const;
+  IRAddress *addr() const;
+  int64_t imd_int() const;
+  double imd_float() const;
 
   IRArgType type() const { return type_; }
 
-  IRInstr *instr() const { return instr_; }
-  void set_instr(IRInstr *instr) { instr_ = instr; }
-
   friend std::ostream &operator<<(std::ostream &os, IRArg);
 
 private:
-  std::variant<IRLabel *, IRVar *, IRGlobal *, int, double> data_;
   IRArgType type_;
-  IRInstr *instr_ = nullptr;
+  union {
+    IRLabel *label_;
+    IRVar *var_;
+    IRGlobal *global_;
+    int64_t int_;
+    double float_;
+  };
 };
 
+/* addresses an instruction reads, at most three */
+class IROperands {
+public:
+  void push_back(IRAddress *addr) { addrs_[size_++] = addr; }
+
+  IRAddress *const *begin() const { return addrs_; }
+  IRAddress *const *end() const { return addrs_ + size_; }
+  size_t size() const { return size_; }
+
+  bool contains(IRAddress *addr) const {
+    return std::find(begin(), end(), addr) != end();
+  }
+
+private:
+  IRAddress *addrs_[3];
+  uint8_t size_ = 0;
+};
+
+/* Fixed size, trivially copyable instruction record. What it reads and
+ * writes follows from the opcode, so it's worked out on demand instead of
+ * being stored. */
 class IRInstr {
   friend class IRBlock;
+  friend class IRProc;
 
 public:
-  typedef std::set<IRAddress *> NextUseInfo;
   IRInstr(IROp op);
   IRInstr(IROp op, IRArg opr1);
   IRInstr(IROp op, IRArg opr1, IRArg opr2);
@@ -126,19 +155,30 @@ public:
   IROp op() const { return op_; }
   bool is_jump() const { return ::is_jump(op_); }
 
-  bool has_arg1() const { return (bool)arg1_; }
-  bool has_arg2() const { return (bool)arg2_; }
-  bool has_arg3() const { return (bool)arg3_; }
+  bool has_arg1() const { return nargs_ >= 1; }
+  bool has_arg2() const { return nargs_ >= 2; }
+  bool has_arg3() const { return nargs_ >= 3; }
 
   IRArg arg1() const;
   IRArg arg2() const;
   IRArg arg3() const;
+  /* replace operand i (0 to 2), which the instruction must have */
+  void set_arg(int i, IRArg arg) {
+    assert(i < nargs_);
+    args_[i] = arg;
+  }
+
+  /* address of operand i (0 to 2), null if it isn't one */
+  IRAddress *operand(int i) const {
+    return i < nargs_ && args_[i].is_addr() ? args_[i].addr() : nullptr;
+  }
 
-  const NextUseInfo &next_use() const { return next_use_; }
-  void set_next_use(NextUseInfo nu) { next_use_ = std::move(nu); }
+  /* where in the block the address of operand i is read next after this
+   * instruction, see NextUse */
+  uint32_t next_use(int i) const { return next_use_[i]; }
 
-  const std::set<IRAddress *> &srcs() { return src_vars_; }
-  IRAddress *dest() { return dest_var_; }
+  IROperands srcs() const;
+  IRAddress *dest() const;
 
   IRBlock *block() { return block_; }
 
@@ -148,21 +188,17 @@ public:
   int source_line() { return source_line_; }
 
 private:
-  std::set<IRAddress *> find_srcs();
-  IRAddress *find_dest();
-
   void set_block(IRBlock *block) { block_ = block; }
 
   IROp op_;
-  std::optional<IRArg> arg1_;
-  std::optional<IRArg> arg2_;
-  std::optional<IRArg> arg3_;
+  uint8_t nargs_;
+  IRArg args_[3];
 
-  NextUseInfo next_use_;
+  std::array<uint32_t, 3> next_use_;
+  int32_t source_line_ = 0;
 
-  std::set<IRAddress *> src_vars_;
-  IRAddress *dest_var_;
-
-  IRBlock *block_;
-  int source_line_ = 0;
+  IRBlock *block_ = nullptr;
 };
+
+static_assert(std::is_trivially_copyable_v<IRArg>);
+static_assert(std::is_trivially_copyable_v<IRInstr>);
@@ -1,5 +1,10 @@
 #include "ir_proc.h"
+#include "dce.h"
+#include "next_use.h"
+#include "sccp.h"
+#include "ssa.h"
 #include <algorithm>
+#include <chrono>
 #include <stack>
 #include <unordered_set>
 
@@ -11,6 +16,15 @@ void IRProc::add_instr(IRInstr instr) {
     current_block_ = std::make_unique<IRBlock>(this, blocks_.size());
   }
 
+  for (int k = 0; k < 3; k++) {
+    if (auto addr = instr.operand(k)) {
+      int i = number(addr);
+      if (addr->is_global()) {
+        instr.args_[k] = IRArg(addresses_[i]->global());
+      }
+    }
+  }
+
   /* end block if instr is a jump */
   bool jmp = instr.is_jump();
   current_block_->add_instr(std::move(instr));
@@ -35,7 +49,7 @@ void IRProc::end_proc() {
   if (current_block_) {
     add_block();
   }
-  process();
+  instrs_.shrink_to_fit();
 }
 
 void IRProc::add_block() {
@@ -43,8 +57,35 @@ void IRProc::add_block() {
   blocks_.push_back(std::move(current_block_));
 }
 
-void IRProc::process() { /* now perform variable use information */
+void IRProc::process(IRPasses passes) {
+  assert(sealed_);
   find_succ_pre();
+  if (passes.ssa || passes.sccp) {
+    auto start = std::chrono::steady_clock::now();
+    SSA ssa(this);
+    if (passes.sccp && ssa.converted()) {
+      SCCP sccp(this, ssa);
+      sccp_consts_ = sccp.consts();
+      sccp_branches_ = sccp.branches();
+    }
+    ssa.destroy();
+    /* what the folded branches no longer lead to */
+    size_t blocks = blocks_.size();
+    remove_unreachable();
+    sccp_blocks_ = blocks - blocks_.size();
+    ssa_phis_ = ssa.phis();
+    ssa_copies_ = ssa.copies();
+    ssa_micros_ = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+  }
+  if (passes.dce) {
+    DCE dce(this);
+    dce_before_ = dce.before();
+    dce_after_ = dce.after();
+    dce_rounds_ = dce.rounds();
+  }
+  /* now perform variable use information */
   find_liveness();
   find_next_use();
   find_first_defs();
@@ -95,9 +136,12 @@ void IRProc::find_succ_pre() {
     }
   }
 
+  remove_unreachable();
+}
+
+void IRProc::remove_unreachable() {
   if (blocks_.size()) {
     /* perform dfs */
-    /* remove unreachable blocks */
     std::set<IRBlock *> visited;
     std::stack<IRBlock *> stack;
     stack.push(blocks_[0].get());
@@ -114,52 +158,128 @@ void IRProc::find_succ_pre() {
       }
     }
 
+    /* unreachable blocks can still jump into reachable ones */
     for (auto &block : blocks_) {
-      if (!visited.contains(block.get())) {
-        remove_block(block.get());
-      }
+      std::erase_if(block->pred_,
+                    [&](IRBlock *pred) { return !visited.contains(pred); });
     }
+    std::erase_if(blocks_, [&](auto &block) {
+      return !visited.contains(block.get());
+    });
   }
 }
 
-void IRProc::find_liveness() {
-  /* now perform liveness analysis */
-  bool change = true;
-  while (change) {
-    change = false;
+std::vector<IRBlock *> IRProc::solve_order(Direction direction) {
+  /* depth first from the entry, or backwards from every exit */
+  std::vector<IRBlock *> roots;
+  if (direction == Direction::FORWARD) {
+    if (blocks_.size()) {
+      roots.push_back(blocks_[0].get());
+    }
+  } else {
     for (auto &block : blocks_) {
-      /* initialise as empty */
-      block->live_out_.clear();
-      for (auto succ : block->succ_) {
-        /* union of all successor IN */
-        block->live_out_.insert(succ->live_in_.begin(), succ->live_in_.end());
+      if (block->succ_.empty()) {
+        roots.push_back(block.get());
       }
+    }
+  }
 
-      /* to check for change */
-      auto old_in = std::move(block->live_in_);
-      block->live_in_.clear();
-      /* OUT - def */
-      std::set_difference(
-          block->live_out_.begin(), block->live_out_.end(), //
-          block->def_.begin(), block->def_.end(),           //
-          std::inserter(block->live_in_, block->live_in_.end()));
-      /* IN = use ∪ (OUT - def) */
-      block->live_in_.insert(block->use_.begin(), block->use_.end());
-
-      if (!change) {
-        /* check for change */
-        if (old_in != block->live_in_) {
-          change = true;
+  std::vector<IRBlock *> order;
+  std::set<IRBlock *> visited;
+  /* block and how many of its edges have been followed */
+  std::stack<std::pair<IRBlock *, size_t>> stack;
+  for (auto root : roots) {
+    if (!visited.insert(root).second) {
+      continue;
+    }
+    stack.push({root, 0});
+    while (!stack.empty()) {
+      auto &[c, next] = stack.top();
+      auto &edges = direction == Direction::FORWARD ? c->succ_ : c->pred_;
+      if (next < edges.size()) {
+        auto n = edges[next++];
+        if (visited.insert(n).second) {
+          stack.push({n, 0});
         }
+      } else {
+        order.push_back(c);
+        stack.pop();
+      }
+    }
+  }
+  std::reverse(order.begin(), order.end());
+
+  /* blocks that never reach an exit (infinite loops), last to first */
+  for (auto itr = blocks_.rbegin(); itr != blocks_.rend(); ++itr) {
+    if (!visited.contains(itr->get())) {
+      order.push_back(itr->get());
+    }
+  }
+  return order;
+}
+
+int IRProc::index(IRAddress *addr) {
+  if (addr->is_var()) {
+    /* -1 until this proc numbers it, vars belong to a single proc */
+    int i = addr->var()->index();
+    return i >= 0 && size_t(i) < addresses_.size() && addresses_[i] == addr
+               ? i
+               : -1;
+  }
+  size_t id = addr->global()->id();
+  return id < global_indices_.size() ? global_indices_[id] : -1;
+}
+
+int IRProc::number(IRAddress *addr) {
+  int i = index(addr);
+  if (i < 0) {
+    i = addresses_.size();
+    addresses_.push_back(addr);
+    if (addr->is_var()) {
+      addr->var()->set_index(i);
+    } else {
+      size_t id = addr->global()->id();
+      if (id >= global_indices_.size()) {
+        global_indices_.resize(id + 1, -1);
       }
+      global_indices_[id] = i;
+      globals_.push_back(*addr->global());
+      addresses_.back() = &globals_.back();
     }
   }
+  return i;
+}
+
+void IRProc::find_liveness() {
+  /* same size everywhere, so the transfer function is a straight loop */
+  for (auto &block : blocks_) {
+    block->use_.resize(addresses_.size());
+    block->def_.resize(addresses_.size());
+    block->live_in_.resize(addresses_.size());
+    block->live_out_.resize(addresses_.size());
+    /* this can run again, and what an earlier run found would survive
+     * around loops */
+    block->live_in_.clear();
+  }
+
+  /* now perform liveness analysis */
+  liveness_visits_ = solve(Direction::BACKWARD, [](IRBlock *block) {
+    /* union of all successor IN */
+    block->live_out_.clear();
+    for (auto succ : block->succ_) {
+      block->live_out_.unite(succ->live_in_);
+    }
+    /* IN = use ∪ (OUT - def) */
+    return block->live_in_.assign_union_difference(
+        block->use_, block->live_out_, block->def_);
+  });
 }
 
 void IRProc::find_next_use() {
   /* now find next use of all blocks */
+  std::vector<uint32_t> next(addresses_.size(), NextUse::UNSET);
   for (auto &block : blocks_) {
-    block->find_next_use();
+    block->find_next_use(next);
   }
 }
 
@@ -171,7 +291,10 @@ void IRProc::find_first_defs() {
     stack.push(n);
     std::set<IRBlock *> visited;
 
-    std::set<IRVar *> vars;
+    BitSet vars(addresses_.size());
+    for (auto &block : blocks_) {
+      block->first_def_.clear();
+    }
 
     while (!stack.empty()) {
       auto c = stack.top();
@@ -182,12 +305,12 @@ void IRProc::find_first_defs() {
       }
       visited.insert(c);
 
-      for (auto &var : c->ref_) {
+      c->ref_.for_each([&](size_t var) {
         if (!vars.contains(var)) {
           c->first_def_.insert(var);
           vars.insert(var);
         }
-      }
+      });
 
       for (auto &succ : c->succ_) {
         stack.push(succ);
@@ -197,39 +320,27 @@ void IRProc::find_first_defs() {
 }
 
 void IRProc::find_var_liveness() {
-  /* now perform liveness analysis */
-  bool change = true;
-  while (change) {
-    change = false;
-    for (auto &block : blocks_) {
-      /* initialise as empty */
-      block->var_out_.clear();
-      for (auto succ : block->succ_) {
-        /* union of all successor IN */
-        block->var_out_.insert(succ->var_in_.begin(), succ->var_in_.end());
-      }
-
-      /* to check for change */
-      auto old_in = std::move(block->var_in_);
-      block->var_in_.clear();
-      /* ref - first_def */
-      std::set_union(block->ref_.begin(), block->ref_.end(),         //
-                     block->var_out_.begin(), block->var_out_.end(), //
-                     std::inserter(block->var_in_, block->var_in_.end()));
-
-      for (auto &var : block->first_def_) {
-        block->var_in_.erase(var);
-      }
-      /* IN = (OUT ∪ ref) - first_def */
+  /* (OUT ∪ ref) - first_def = (ref - first_def) ∪ (OUT - first_def) */
+  for (auto &block : blocks_) {
+    block->first_def_.resize(addresses_.size());
+    block->var_in_.resize(addresses_.size());
+    block->var_out_.resize(addresses_.size());
+    block->var_gen_ = BitSet(addresses_.size());
+    block->var_gen_.unite(block->ref_);
+    block->var_gen_.subtract(block->first_def_);
+  }
 
-      if (!change) {
-        /* check for change */
-        if (old_in != block->var_in_) {
-          change = true;
-        }
-      }
+  /* now perform liveness analysis */
+  var_liveness_visits_ = solve(Direction::BACKWARD, [](IRBlock *block) {
+    /* union of all successor IN */
+    block->var_out_.clear();
+    for (auto succ : block->succ_) {
+      block->var_out_.unite(succ->var_in_);
     }
-  }
+    /* IN = (OUT ∪ ref) - first_def */
+    return block->var_in_.assign_union_difference(
+        block->var_gen_, block->var_out_, block->first_def_);
+  });
 }
 
 void IRProc::alloc_vars() {
@@ -237,9 +348,10 @@ void IRProc::alloc_vars() {
   if (blocks_.size()) {
     auto n = blocks_[0].get();
     /* param definitions should be in first block */
-    int end = 0;
-    for (int i = 0; i < n->instrs_.size(); i++) {
-      auto &instr = n->instrs_[i];
+    int end = n->size();
+    auto instrs = n->instrs();
+    for (int i = 0; i < instrs.size(); i++) {
+      auto &instr = instrs[i];
       if (instr.op() != IROp::PALLOC) {
         end = i;
         break;
@@ -248,7 +360,7 @@ void IRProc::alloc_vars() {
     // asign offset from the last
     int poff = -1;
     for (int i = end - 1; i >= 0; i--) {
-      auto &instr = n->instrs_[i];
+      auto &instr = instrs[i];
       instr.arg1().var()->set_offset(poff--);
       instr.arg1().var()->set_dirty(false);
     }
@@ -276,6 +388,21 @@ void IRProc::alloc_vars() {
   }
 }
 
+void IRProc::set_instrs(std::vector<std::vector<IRInstr>> instrs) {
+  assert(instrs.size() == blocks_.size());
+  instrs_.clear();
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    auto &block = blocks_[i];
+    block->begin_ = instrs_.size();
+    for (auto &instr : instrs[i]) {
+      instr.set_block(block.get());
+      instrs_.push_back(instr);
+    }
+    block->end_ = instrs_.size();
+    block->find_refs();
+  }
+}
+
 void IRProc::remove_block(IRBlock *block) {
   for (auto itr = blocks_.begin(); itr != blocks_.end(); ++itr) {
     if (itr->get() == block) {
@@ -1,10 +1,27 @@
 #pragma once
 
+#include <deque>
 #include <memory>
 
 #include "ir_block.h"
 
+/* optional passes IRProc::process runs on the flow graph before the
+ * analyses */
+struct IRPasses {
+  /* convert to SSA form and back, see SSA */
+  bool ssa = false;
+  /* propagate constants and fold branches in SSA form, see SCCP */
+  bool sccp = false;
+  /* propagate copies and delete dead code, see DCE */
+  bool dce = false;
+};
+
 class IRProc {
+  friend class IRBlock;
+  friend class SSA;
+  friend class SCCP;
+  friend class DCE;
+
 public:
   IRProc(std::string name);
 
@@ -13,28 +30,133 @@ public:
 
   std::string_view name() { return name_; }
 
-  /* perform liveness analysis */
-  void process();
-  /* seal and call process */
+  /* perform liveness analysis and allocate the stack frame, the proc must
+   * be sealed. Only touches the proc, its vars and its globals, so procs
+   * can be processed concurrently. */
+  void process(IRPasses passes = {});
+  /* seal, no more instructions can be added */
   void end_proc();
 
   std::vector<std::unique_ptr<IRBlock>> &blocks() { return blocks_; }
 
   void remove_block(IRBlock *block);
 
+  enum class Direction { FORWARD, BACKWARD };
+
+  /* Worklist dataflow solver. Blocks are ranked in reverse postorder of the
+   * flow graph (FORWARD) or of the reversed flow graph (BACKWARD) and all
+   * start out queued; transfer(block) is then applied to the lowest ranked
+   * queued block until none is left. transfer recomputes the block's facts
+   * from its neighbours and returns whether its output changed, which
+   * queues the blocks reading it (successors for FORWARD, predecessors for
+   * BACKWARD) again. Returns the number of transfer calls. */
+  template <class Transfer>
+  size_t solve(Direction direction, Transfer transfer);
+
+  /* number of transfer calls made by each analysis, for --stats */
+  size_t liveness_visits() { return liveness_visits_; }
+  size_t var_liveness_visits() { return var_liveness_visits_; }
+  /* phis placed and copies they turned into, and the microseconds it all
+   * took, with IRPasses::ssa */
+  size_t ssa_phis() { return ssa_phis_; }
+  size_t ssa_copies() { return ssa_copies_; }
+  size_t ssa_micros() { return ssa_micros_; }
+  /* definitions found constant, branches folded and blocks left
+   * unreachable, with IRPasses::sccp */
+  size_t sccp_consts() { return sccp_consts_; }
+  size_t sccp_branches() { return sccp_branches_; }
+  size_t sccp_blocks() { return sccp_blocks_; }
+  /* instructions before and after, declarations aside, and the rounds it
+   * took, with IRPasses::dce */
+  size_t dce_before() { return dce_before_; }
+  size_t dce_after() { return dce_after_; }
+  size_t dce_rounds() { return dce_rounds_; }
+
+  /* Addresses referenced in the proc are numbered densely in order of first
+   * appearance; index is the bit standing for addr in the blocks' dataflow
+   * sets, -1 if the proc doesn't reference it */
+  int index(IRAddress *addr);
+  IRAddress *address(size_t index) { return addresses_[index]; }
+  size_t num_addresses() { return addresses_.size(); }
+
+  /* The proc's own copies of the globals it references, its instructions
+   * point to these. Which registers hold a global is only meaningful
+   * within one proc, so keeping that on a copy lets procs be generated
+   * concurrently. */
+  std::deque<IRGlobal> &globals() { return globals_; }
+
 private:
+  /* index of addr, numbering it if it's new */
+  int number(IRAddress *addr);
+
   void find_succ_pre();
+  /* delete the blocks the entry doesn't reach */
+  void remove_unreachable();
   void find_liveness();
   void find_next_use();
   void find_first_defs();
   void find_var_liveness();
   void alloc_vars();
 
+  /* makes instrs[i] the instructions of blocks_[i] and finds their use and
+   * def again */
+  void set_instrs(std::vector<std::vector<IRInstr>> instrs);
+
+  /* blocks in the order solve first visits them */
+  std::vector<IRBlock *> solve_order(Direction direction);
+
   void add_block();
   std::vector<std::unique_ptr<IRBlock>> blocks_;
   std::string name_;
 
   std::unique_ptr<IRBlock> current_block_;
+  /* every instruction of the proc, blocks refer to ranges of it */
+  std::vector<IRInstr> instrs_;
+
+  std::vector<IRAddress *> addresses_;
+  /* globals are shared by every proc, so their index is kept here by
+   * IRGlobal::id rather than on the global */
+  std::vector<int> global_indices_;
+  std::deque<IRGlobal> globals_;
+  /* vars made by the passes, the SSA versions */
+  std::deque<IRVar> vars_;
+
+  size_t liveness_visits_ = 0;
+  size_t var_liveness_visits_ = 0;
+  size_t ssa_phis_ = 0;
+  size_t ssa_copies_ = 0;
+  size_t ssa_micros_ = 0;
+  size_t sccp_consts_ = 0;
+  size_t sccp_branches_ = 0;
+  size_t sccp_blocks_ = 0;
+  size_t dce_before_ = 0;
+  size_t dce_after_ = 0;
+  size_t dce_rounds_ = 0;
 
   bool sealed_ = false;
 };
+
+template <class Transfer>
+size_t IRProc::solve(Direction direction, Transfer transfer) {
+  auto order = solve_order(direction);
+  BitSet worklist(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i]->rank_ = i;
+    worklist.insert(i);
+  }
+
+  size_t visits = 0;
+  for (size_t i; (i = worklist.first()) < order.size();) {
+    worklist.erase(i);
+    visits++;
+    auto block = order[i];
+    if (transfer(block)) {
+      auto &readers =
+          direction == Direction::FORWARD ? block->succ_ : block->pred_;
+      for (auto reader : readers) {
+        worklist.insert(reader->rank_);
+      }
+    }
+  }
+  return visits;
+}
@@ -1 +1,63 @@
 #include "ir_program.h"
+
+#include <fmt/core.h>
+
+void IRProgram::print_stats(std::FILE *out) {
+  fmt::print(out, "{:<20} {:>8} {:>10} {:>13}\n", "proc", "blocks",
+             "liveness", "var liveness");
+  size_t blocks = 0, liveness = 0, var_liveness = 0;
+  for (auto &proc : procs_) {
+    fmt::print(out, "{:<20} {:>8} {:>10} {:>13}\n", proc->name(),
+               proc->blocks().size(), proc->liveness_visits(),
+               proc->var_liveness_visits());
+    blocks += proc->blocks().size();
+    liveness += proc->liveness_visits();
+    var_liveness += proc->var_liveness_visits();
+  }
+  fmt::print(out, "{:<20} {:>8} {:>10} {:>13}\n", "total", blocks, liveness,
+             var_liveness);
+  if (blocks) {
+    fmt::print(out, "{:<20} {:>8} {:>10.2f} {:>13.2f}\n", "visits per block",
+               "", double(liveness) / blocks, double(var_liveness) / blocks);
+  }
+
+  /* what going through SSA form cost, if it was asked for */
+  size_t phis = 0, copies = 0, micros = 0;
+  for (auto &proc : procs_) {
+    phis += proc->ssa_phis();
+    copies += proc->ssa_copies();
+    micros += proc->ssa_micros();
+  }
+  if (phis || copies || micros) {
+    fmt::print(out, "{:<20} {:>8} {:>10} {:>13}\n", "ssa", "phis", "copies",
+               "time (us)");
+    fmt::print(out, "{:<20} {:>8} {:>10} {:>13}\n", "total", phis, copies,
+               micros);
+  }
+
+  size_t consts = 0, branches = 0, removed = 0;
+  for (auto &proc : procs_) {
+    consts += proc->sccp_consts();
+    branches += proc->sccp_branches();
+    removed += proc->sccp_blocks();
+  }
+  if (consts || branches || removed) {
+    fmt::print(out, "{:<20} {:>8} {:>10} {:>13}\n", "sccp", "consts",
+               "branches", "dead blocks");
+    fmt::print(out, "{:<20} {:>8} {:>10} {:>13}\n", "total", consts,
+               branches, removed);
+  }
+
+  size_t before = 0, after = 0, rounds = 0;
+  for (auto &proc : procs_) {
+    before += proc->dce_before();
+    after += proc->dce_after();
+    rounds += proc->dce_rounds();
+  }
+  if (rounds) {
+    fmt::print(out, "{:<20} {:>8} {:>10} {:>13}\n", "dce", "before", "after",
+               "rounds");
+    fmt::print(out, "{:<20} {:>8} {:>10} {:>13}\n", "total", before, after,
+               rounds);
+  }
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdio>
+#include <deque>
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -8,7 +10,7 @@
 #include "ir_proc.h"
 
 class IRProgram {
-  friend class IRParser;
+  friend class IRBuilder;
 
 public:
   auto &globals() { return globals_; }
@@ -16,9 +18,19 @@ public:
   auto &labels() { return labels_; }
   auto &vars() { return vars_; }
 
+  /* blocks per proc and how many block visits its dataflow passes took */
+  void print_stats(std::FILE *out);
+
 private:
-  std::unordered_map<std::string, std::unique_ptr<IRGlobal>> globals_;
-  std::unordered_map<int, std::unique_ptr<IRLabel>> labels_;
-  std::unordered_map<int, std::unique_ptr<IRVar>> vars_;
+  /* Globals and labels are indexed by id, which the IR numbers densely;
+   * vars are per proc, in order of first appearance. Deques, so growing
+   * them never moves what operands point to. */
+  std::deque<IRGlobal> globals_;
+  std::deque<IRLabel> labels_;
+  std::deque<IRVar> vars_;
+  /* labels with an id too far out to index by, see IRBuilder::DENSE_IDS */
+  std::unordered_map<size_t, IRLabel> far_labels_;
+  /* globals by their name in the IR */
+  std::unordered_map<std::string, IRGlobal *> global_names_;
   std::vector<std::unique_ptr<IRProc>> procs_;
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <variant>
+
 #include "ir_instr.h"
 
 class IRToken {
@@ -0,0 +1,77 @@
+#include "next_use.h"
+#include "ir_proc.h"
+
+void NextUse::start_block(IRBlock *block) {
+  if (block->proc() != proc_) {
+    proc_ = block->proc();
+    next_.assign(proc_->num_addresses(), UNSET);
+  } else {
+    for (auto i : touched_) {
+      next_[i] = UNSET;
+    }
+  }
+  touched_.clear();
+  block_ = block;
+  current_ = nullptr;
+  pos_ = UINT32_MAX;
+
+  /* a value held since the block was entered is read next where the block
+   * first references its address, unless that overwrites it */
+  auto instrs = block->instrs();
+  for (uint32_t pos = 0; pos < instrs.size(); pos++) {
+    auto &instr = instrs[pos];
+    for (auto src : instr.srcs()) {
+      auto i = proc_->index(src);
+      if (next_[i] == UNSET) {
+        touched_.push_back(i);
+        next_[i] = pos;
+      }
+    }
+    if (auto dest = instr.dest()) {
+      auto i = proc_->index(dest);
+      if (next_[i] == UNSET) {
+        touched_.push_back(i);
+        next_[i] = DEAD;
+      }
+    }
+  }
+}
+
+void NextUse::advance(IRInstr *instr) {
+  assert(instr->block() == block_);
+  current_ = instr;
+  pos_++;
+  for (int k = 0; k < 3; k++) {
+    if (auto addr = instr->operand(k)) {
+      auto i = proc_->index(addr);
+      if (next_[i] == UNSET) {
+        touched_.push_back(i);
+      }
+      next_[i] = instr->next_use(k);
+    }
+  }
+}
+
+uint32_t NextUse::position(IRInstr *instr, IRAddress *addr) const {
+  assert(instr == current_);
+  int i = proc_->index(addr);
+  if (i < 0) {
+    return DEAD;
+  }
+  if (next_[i] == UNSET) {
+    /* not referenced in the block */
+    return block_->live_on_exit().contains(i) ? LIVE_OUT : DEAD;
+  }
+  return next_[i];
+}
+
+uint32_t NextUse::distance(IRInstr *instr, IRAddress *addr) const {
+  auto next = position(instr, addr);
+  if (next == DEAD) {
+    return DEAD;
+  }
+  if (next == LIVE_OUT) {
+    next = block_->size();
+  }
+  return next - pos_;
+}
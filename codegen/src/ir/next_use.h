@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class IRAddress;
+class IRBlock;
+class IRInstr;
+class IRProc;
+
+/* Next use information while walking a block forward during code
+ * generation. Every instruction records where the addresses of its own
+ * operands are read next (IRInstr::next_use), so advancing costs one store
+ * per operand and asking about any address is an array lookup, by
+ * IRProc::index. */
+class NextUse {
+public:
+  /* overwritten or never read again */
+  static constexpr uint32_t DEAD = UINT32_MAX;
+  /* not read again in the block, but live on exit */
+  static constexpr uint32_t LIVE_OUT = UINT32_MAX - 1;
+  /* not referenced in the block yet */
+  static constexpr uint32_t UNSET = UINT32_MAX - 2;
+
+  void start_block(IRBlock *block);
+  /* instr is the next instruction of the block, about to be generated */
+  void advance(IRInstr *instr);
+
+  /* position in the block of the next read of addr after the current
+   * instruction, or LIVE_OUT or DEAD */
+  uint32_t position(IRInstr *instr, IRAddress *addr) const;
+  bool used_again(IRInstr *instr, IRAddress *addr) const {
+    return position(instr, addr) != DEAD;
+  }
+  /* instructions until that read, a value live on exit counts as read just
+   * past the end of the block. DEAD if there is none. */
+  uint32_t distance(IRInstr *instr, IRAddress *addr) const;
+
+private:
+  IRProc *proc_ = nullptr;
+  IRBlock *block_ = nullptr;
+  IRInstr *current_ = nullptr;
+  uint32_t pos_ = 0;
+
+  /* by IRProc::index, UNSET unless in touched_ */
+  std::vector<uint32_t> next_;
+  std::vector<uint32_t> touched_;
+};
@@ -0,0 +1,439 @@
+#include "sccp.h"
+#include "ssa.h"
+
+#include <algorithm>
+#include <optional>
+
+static bool is_comparison(IROp op) {
+  switch (op) {
+  case IROp::LESS:
+  case IROp::LEQ:
+  case IROp::GREAT:
+  case IROp::GEQ:
+  case IROp::EQ:
+  case IROp::NEQ:
+    return true;
+  default:
+    return false;
+  }
+}
+
+/* op on the words a and b (just a if it takes one), none if the 8086
+ * would fault or it isn't folded */
+static std::optional<int16_t> fold(IROp op, int16_t a, int16_t b) {
+  int32_t x = a, y = b;
+  switch (op) {
+  case IROp::INC:
+    return x + 1;
+  case IROp::DEC:
+    return x - 1;
+  case IROp::NEG:
+    return -x;
+  case IROp::NOT:
+    return ~x;
+  case IROp::ADD:
+    return x + y;
+  case IROp::SUB:
+    return x - y;
+  case IROp::MUL:
+    return x * y;
+  case IROp::DIV:
+  case IROp::MOD:
+    if (y == 0 || (x == INT16_MIN && y == -1)) {
+      return std::nullopt;
+    }
+    return op == IROp::DIV ? x / y : x % y;
+  case IROp::AND:
+    return x & y;
+  case IROp::OR:
+    return x | y;
+  case IROp::XOR:
+    return x ^ y;
+  case IROp::LSHIFT:
+  case IROp::RSHIFT:
+    if (y < 0 || y > 15) {
+      return std::nullopt;
+    }
+    return op == IROp::LSHIFT ? int32_t(uint32_t(x) << y) : x >> y;
+  case IROp::LESS:
+    return x < y;
+  case IROp::LEQ:
+    return x <= y;
+  case IROp::GREAT:
+    return x > y;
+  case IROp::GEQ:
+    return x >= y;
+  case IROp::EQ:
+    return x == y;
+  case IROp::NEQ:
+    return x != y;
+  default:
+    return std::nullopt;
+  }
+}
+
+SCCP::SCCP(IRProc *proc, const SSA &ssa) : proc_(proc) {
+  auto &blocks = proc_->blocks();
+  reached_.assign(blocks.size(), false);
+  for (size_t b = 0; b < blocks.size(); b++) {
+    position_[blocks[b].get()] = b;
+    taken_.emplace_back(blocks[b]->predecessors().size());
+  }
+  find_uses(ssa);
+  propagate();
+  rewrite();
+}
+
+void SCCP::find_uses(const SSA &ssa) {
+  size_t n = proc_->num_addresses();
+  values_.assign(n, {Value::Kind::BOTTOM});
+  for (size_t i = 0; i < n; i++) {
+    if (ssa.is_version(i)) {
+      values_[i] = {Value::Kind::TOP};
+    }
+  }
+
+  uses_.assign(n, {});
+  auto add = [&](IRAddress *addr, Use use) {
+    if (addr && addr->is_var() && ssa.is_version(proc_->index(addr))) {
+      uses_[proc_->index(addr)].push_back(use);
+    }
+  };
+  for (auto &block : proc_->blocks()) {
+    auto instrs = block->instrs();
+    for (uint32_t pos = 0; pos < instrs.size(); pos++) {
+      for (int k = 0; k < 3; k++) {
+        if (!SSA::writes(instrs[pos], k)) {
+          add(instrs[pos].operand(k), {block.get(), pos, false});
+        }
+      }
+    }
+    auto &phis = block->phis();
+    for (uint32_t pos = 0; pos < phis.size(); pos++) {
+      for (auto arg : phis[pos].args) {
+        add(arg.is_var() ? arg.var() : nullptr, {block.get(), pos, true});
+      }
+    }
+  }
+}
+
+void SCCP::propagate() {
+  reach(0);
+  while (!edges_.empty() || !lowered_.empty()) {
+    if (!edges_.empty()) {
+      auto [from, to] = edges_.back();
+      edges_.pop_back();
+      size_t b = position_[to];
+      /* a block can be in there twice, if it jumps to where it falls
+       * through; both edges carry the same values */
+      bool first = false;
+      auto &preds = to->predecessors();
+      for (size_t j = 0; j < preds.size(); j++) {
+        if (preds[j] == from && !taken_[b][j]) {
+          taken_[b][j] = first = true;
+        }
+      }
+      if (!first) {
+        continue;
+      }
+      if (!reached_[b]) {
+        reach(b);
+      } else {
+        for (size_t pos = 0; pos < to->phis().size(); pos++) {
+          visit_phi(to, pos);
+        }
+      }
+      continue;
+    }
+
+    size_t i = lowered_.back();
+    lowered_.pop_back();
+    for (auto use : uses_[i]) {
+      if (!reached_[position_[use.block]]) {
+        continue;
+      }
+      if (use.phi) {
+        visit_phi(use.block, use.pos);
+      } else {
+        visit(use.block, use.pos);
+      }
+    }
+  }
+}
+
+void SCCP::reach(size_t b) {
+  reached_[b] = true;
+  auto block = proc_->blocks()[b].get();
+  for (size_t pos = 0; pos < block->phis().size(); pos++) {
+    visit_phi(block, pos);
+  }
+  for (size_t pos = 0; pos < block->size(); pos++) {
+    visit(block, pos);
+  }
+  visit_branch(block);
+}
+
+void SCCP::visit(IRBlock *block, size_t pos) {
+  auto &instr = block->instrs()[pos];
+  if (is_comparison(instr.op()) || instr.op() == IROp::JMPIF ||
+      instr.op() == IROp::JMPIFNOT) {
+    visit_branch(block);
+    return;
+  }
+  for (int k = 0; k < 3; k++) {
+    auto addr = instr.operand(k);
+    if (addr && SSA::writes(instr, k)) {
+      lower(addr, evaluate(instr));
+    }
+  }
+}
+
+void SCCP::visit_phi(IRBlock *block, size_t pos) {
+  auto &phi = block->phis()[pos];
+  auto &taken = taken_[position_[block]];
+  Value merged{Value::Kind::TOP};
+  for (size_t j = 0; j < phi.args.size(); j++) {
+    if (!taken[j]) {
+      continue;
+    }
+    auto v = value(phi.args[j]);
+    if (merged.kind == Value::Kind::TOP) {
+      merged = v;
+    } else if (v.kind != Value::Kind::TOP && !(v == merged)) {
+      merged = {Value::Kind::BOTTOM};
+    }
+  }
+  lower(phi.dest, merged);
+}
+
+void SCCP::visit_branch(IRBlock *block) {
+  auto &succ = block->successors();
+  if (auto cond = condition(block); cond.kind != Value::Kind::BOTTOM) {
+    /* the target of the jump comes first, then where it falls through */
+    if (cond.kind == Value::Kind::CONST && (cond.c ? 0u : 1u) < succ.size()) {
+      take(block, succ[cond.c ? 0 : 1]);
+    }
+    return;
+  }
+  for (auto to : succ) {
+    take(block, to);
+  }
+}
+
+void SCCP::take(IRBlock *from, IRBlock *to) { edges_.push_back({from, to}); }
+
+void SCCP::lower(IRAddress *addr, Value value) {
+  /* only versions start out above the bottom, and nothing goes back up */
+  size_t i = proc_->index(addr);
+  if (values_[i].kind == Value::Kind::BOTTOM || values_[i] == value) {
+    return;
+  }
+  values_[i] = value;
+  lowered_.push_back(i);
+}
+
+SCCP::Value SCCP::value(IRArg arg) {
+  if (arg.is_imd_int()) {
+    auto c = arg.imd_int();
+    return c >= INT16_MIN && c <= INT16_MAX
+               ? Value{Value::Kind::CONST, int16_t(c)}
+               : Value{Value::Kind::BOTTOM};
+  }
+  if (arg.is_var()) {
+    return values_[proc_->index(arg.var())];
+  }
+  return {Value::Kind::BOTTOM};
+}
+
+SCCP::Value SCCP::evaluate(const IRInstr &instr) {
+  Value a, b{Value::Kind::CONST};
+  switch (instr.op()) {
+  case IROp::COPY:
+    return value(instr.arg2());
+  case IROp::INC:
+  case IROp::DEC:
+  case IROp::NEG:
+  case IROp::NOT:
+    a = value(instr.arg2());
+    break;
+  case IROp::ADD:
+  case IROp::SUB:
+  case IROp::MUL:
+  case IROp::DIV:
+  case IROp::MOD:
+  case IROp::AND:
+  case IROp::OR:
+  case IROp::XOR:
+  case IROp::LSHIFT:
+  case IROp::RSHIFT:
+  case IROp::LESS:
+  case IROp::LEQ:
+  case IROp::GREAT:
+  case IROp::GEQ:
+  case IROp::EQ:
+  case IROp::NEQ:
+    a = value(instr.arg2());
+    b = value(instr.arg3());
+    break;
+  default:
+    return {Value::Kind::BOTTOM};
+  }
+  if (a.kind == Value::Kind::BOTTOM || b.kind == Value::Kind::BOTTOM) {
+    return {Value::Kind::BOTTOM};
+  }
+  if (a.kind == Value::Kind::TOP || b.kind == Value::Kind::TOP) {
+    return {Value::Kind::TOP};
+  }
+  auto c = fold(instr.op(), a.c, b.c);
+  return c ? Value{Value::Kind::CONST, *c} : Value{Value::Kind::BOTTOM};
+}
+
+SCCP::Value SCCP::condition(IRBlock *block) {
+  /* the code generator tests the flags, so only a comparison right before
+   * the jump, of what it jumps on, decides it */
+  auto instrs = block->instrs();
+  if (instrs.size() < 2) {
+    return {Value::Kind::BOTTOM};
+  }
+  auto &jump = instrs.back();
+  auto &cmp = instrs[instrs.size() - 2];
+  if ((jump.op() != IROp::JMPIF && jump.op() != IROp::JMPIFNOT) ||
+      !is_comparison(cmp.op()) || cmp.dest() != jump.operand(0)) {
+    return {Value::Kind::BOTTOM};
+  }
+  auto outcome = evaluate(cmp);
+  if (outcome.kind == Value::Kind::CONST) {
+    outcome.c = (outcome.c != 0) == (jump.op() == IROp::JMPIF);
+  }
+  return outcome;
+}
+
+bool SCCP::takes_immediate(const IRInstr &instr, int k) {
+  switch (instr.op()) {
+  case IROp::COPY:
+    return k == 1;
+  case IROp::ADD:
+  case IROp::MUL:
+  case IROp::DIV:
+  case IROp::MOD:
+  case IROp::AND:
+  case IROp::OR:
+  case IROp::XOR:
+    /* one of the two, either */
+    return (k == 1 && instr.operand(2)) || (k == 2 && instr.operand(1));
+  case IROp::SUB:
+    /* an immediate first takes a NEG after */
+  case IROp::LSHIFT:
+  case IROp::RSHIFT:
+  case IROp::LESS:
+  case IROp::LEQ:
+  case IROp::GREAT:
+  case IROp::GEQ:
+  case IROp::EQ:
+  case IROp::NEQ:
+    /* only the second: the first is shifted in place, and a comparison
+     * with an immediate first is swapped without being mirrored */
+    return k == 2 && instr.operand(1);
+  case IROp::PTRST:
+    /* the value stored or the index */
+    return k == 0 || k == 2;
+  case IROp::PTRLD:
+    return k == 2;
+  default:
+    return false;
+  }
+}
+
+void SCCP::rewrite() {
+  auto &blocks = proc_->blocks();
+  auto constant = [&](IRAddress *addr) {
+    return addr && values_[proc_->index(addr)].kind == Value::Kind::CONST;
+  };
+  auto constant_of = [&](IRAddress *addr) {
+    return IRArg((int)values_[proc_->index(addr)].c);
+  };
+
+  /* a comparison goes with the jump on it, if nothing else reads it */
+  std::vector<size_t> reads(proc_->num_addresses());
+  for (size_t b = 0; b < blocks.size(); b++) {
+    if (!reached_[b]) {
+      continue;
+    }
+    for (auto &instr : blocks[b]->instrs()) {
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (addr && !SSA::writes(instr, k)) {
+          reads[proc_->index(addr)]++;
+        }
+      }
+    }
+  }
+
+  std::vector<std::vector<IRInstr>> instrs(blocks.size());
+  for (size_t b = 0; b < blocks.size(); b++) {
+    auto block = blocks[b].get();
+    auto body = block->instrs();
+    auto &out = instrs[b];
+    if (!reached_[b]) {
+      out.assign(body.begin(), body.end());
+      continue;
+    }
+    auto cond = condition(block);
+    bool folded = cond.kind == Value::Kind::CONST;
+    for (size_t pos = 0; pos < body.size(); pos++) {
+      auto instr = body[pos];
+      if (folded && pos == body.size() - 1) {
+        branches_++;
+        if (cond.c) {
+          IRInstr jump(IROp::JMP, instr.arg2());
+          jump.set_source_line(instr.source_line());
+          out.push_back(jump);
+        }
+        continue;
+      }
+      if (folded && pos == body.size() - 2 &&
+          reads[proc_->index(instr.dest())] == 1) {
+        continue;
+      }
+
+      auto dest = instr.dest();
+      if (constant(dest)) {
+        if (instr.op() != IROp::COPY || !instr.arg2().is_imd_int()) {
+          IRInstr copy(IROp::COPY, instr.arg1(), constant_of(dest));
+          copy.set_source_line(instr.source_line());
+          out.push_back(copy);
+          consts_++;
+        } else {
+          out.push_back(instr);
+        }
+        continue;
+      }
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (!SSA::writes(instr, k) && constant(addr) &&
+            takes_immediate(instr, k)) {
+          instr.set_arg(k, constant_of(addr));
+        }
+      }
+      out.push_back(instr);
+    }
+  }
+
+  /* the edges never taken go, along with what the phis get over them */
+  for (size_t b = 0; b < blocks.size(); b++) {
+    auto block = blocks[b].get();
+    auto &preds = block->pred_;
+    for (size_t j = preds.size(); j-- > 0;) {
+      if (taken_[b][j]) {
+        continue;
+      }
+      auto &succ = preds[j]->succ_;
+      succ.erase(std::find(succ.begin(), succ.end(), block));
+      preds.erase(preds.begin() + j);
+      for (auto &phi : block->phis_) {
+        phi.args.erase(phi.args.begin() + j);
+      }
+    }
+  }
+  proc_->set_instrs(std::move(instrs));
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ir_proc.h"
+
+class SSA;
+
+/* Sparse conditional constant propagation (Wegman and Zadeck) over a proc
+ * in SSA form.
+ *
+ * Every version starts out unknown and only goes down, to a constant and
+ * then to not being one, as the instructions and phis defining it are
+ * evaluated; everything else, parameters, globals and the vars SSA leaves
+ * alone, is never a constant. Blocks are only evaluated once an edge into
+ * them is found to be taken, and a conditional jump whose comparison has a
+ * constant outcome takes only one of its edges, so code behind a branch
+ * that is never taken doesn't spoil the values it would define. Arithmetic
+ * is done in 16 bits, as the 8086 does it.
+ *
+ * Then a definition found to be a constant is replaced by a copy of it,
+ * operands that are constants become immediates where the code generator
+ * takes one and conditional jumps with a known outcome become a JMP or go,
+ * along with their comparison. Phis keep their arguments: a constant there
+ * would only turn into a copy of its own when SSA form is destroyed. The
+ * edges never taken are removed from the flow graph, with the phi
+ * arguments coming in over them; the blocks left unreachable are for
+ * IRProc::remove_unreachable to delete once the proc is out of SSA form.
+ * The copies of constants are left for later passes to remove when dead. */
+class SCCP {
+public:
+  /* propagates and rewrites the proc, which ssa must have converted */
+  SCCP(IRProc *proc, const SSA &ssa);
+
+  /* definitions replaced by a constant */
+  size_t consts() { return consts_; }
+  /* conditional jumps folded */
+  size_t branches() { return branches_; }
+
+  /* operand k of instr can be an immediate as far as the code generator
+   * is concerned */
+  static bool takes_immediate(const IRInstr &instr, int k);
+
+private:
+  /* where a version is read: instruction pos of block, or its phi pos */
+  struct Use {
+    IRBlock *block;
+    uint32_t pos;
+    bool phi;
+  };
+
+  /* TOP is not known yet, BOTTOM is not a constant */
+  struct Value {
+    enum class Kind : uint8_t { TOP, CONST, BOTTOM } kind;
+    int16_t c = 0;
+
+    bool operator==(const Value &) const = default;
+  };
+
+  void find_uses(const SSA &ssa);
+  void propagate();
+  void rewrite();
+
+  /* evaluates the whole of a block the first time an edge into it is taken */
+  void reach(size_t b);
+  void visit(IRBlock *block, size_t pos);
+  void visit_phi(IRBlock *block, size_t pos);
+  /* takes the edges out of a block its last instruction can go down */
+  void visit_branch(IRBlock *block);
+  void take(IRBlock *from, IRBlock *to);
+  void lower(IRAddress *addr, Value value);
+
+  Value value(IRArg arg);
+  Value evaluate(const IRInstr &instr);
+  /* outcome of the comparison a conditional jump at the end of block tests,
+   * 1 if it jumps */
+  Value condition(IRBlock *block);
+
+  IRProc *proc_;
+  std::unordered_map<IRBlock *, size_t> position_;
+  /* by IRProc::index */
+  std::vector<Value> values_;
+  std::vector<std::vector<Use>> uses_;
+  /* by position in proc_->blocks(), and for edges by predecessor */
+  std::vector<bool> reached_;
+  std::vector<std::vector<bool>> taken_;
+
+  /* edges found taken and versions whose value went down, to be followed */
+  std::vector<std::pair<IRBlock *, IRBlock *>> edges_;
+  std::vector<size_t> lowered_;
+
+  size_t consts_ = 0;
+  size_t branches_ = 0;
+};
@@ -0,0 +1,570 @@
+#include "ssa.h"
+
+#include <algorithm>
+
+bool SSA::writes(const IRInstr &instr, int k) {
+  if (instr.op() == IROp::CALL) {
+    /* the return value */
+    return k == 1;
+  }
+  return k == 0 && instr.dest();
+}
+
+SSA::SSA(IRProc *proc) : proc_(proc), originals_(proc->num_addresses()) {
+  auto &blocks = proc_->blocks();
+  if (blocks.empty() || !blocks[0]->predecessors().empty()) {
+    return;
+  }
+  converted_ = true;
+  find_candidates();
+  find_dominators();
+  std::vector<BitSet> live_out;
+  find_liveness(candidates_, live_in_, live_out);
+  place_phis();
+  rename();
+}
+
+void SSA::find_candidates() {
+  candidates_ = BitSet(proc_->num_addresses());
+  BitSet excluded(proc_->num_addresses());
+  for (auto &block : proc_->blocks()) {
+    for (auto &instr : block->instrs()) {
+      switch (instr.op()) {
+      case IROp::PTRLD:
+      case IROp::PTRST:
+        if (instr.arg2().is_var()) {
+          excluded.insert(proc_->index(instr.arg2().addr()));
+        }
+        break;
+      case IROp::ADDR:
+        if (instr.arg2().is_var()) {
+          excluded.insert(proc_->index(instr.arg2().addr()));
+        }
+        [[fallthrough]];
+      case IROp::AALLOC:
+      case IROp::LESS:
+      case IROp::LEQ:
+      case IROp::GREAT:
+      case IROp::GEQ:
+      case IROp::EQ:
+      case IROp::NEQ:
+        excluded.insert(proc_->index(instr.arg1().addr()));
+        break;
+      default:
+        break;
+      }
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (addr && addr->is_var()) {
+          candidates_.insert(proc_->index(addr));
+        }
+      }
+    }
+  }
+  candidates_.subtract(excluded);
+}
+
+void SSA::find_dominators() {
+  order_ = proc_->solve_order(IRProc::Direction::FORWARD);
+  for (size_t i = 0; i < order_.size(); i++) {
+    rank_[order_[i]] = i;
+  }
+
+  /* a block's immediate dominator is the nearest common dominator of its
+   * predecessors seen so far; ranks grow away from the entry, so walking up
+   * from the higher ranked of two blocks finds it */
+  constexpr size_t NONE = -1;
+  idom_.assign(order_.size(), NONE);
+  idom_[0] = 0;
+  auto intersect = [&](size_t a, size_t b) {
+    while (a != b) {
+      while (a > b) {
+        a = idom_[a];
+      }
+      while (b > a) {
+        b = idom_[b];
+      }
+    }
+    return a;
+  };
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (size_t b = 1; b < order_.size(); b++) {
+      size_t idom = NONE;
+      for (auto pred : order_[b]->predecessors()) {
+        size_t p = rank_[pred];
+        if (idom_[p] != NONE) {
+          idom = idom == NONE ? p : intersect(p, idom);
+        }
+      }
+      if (idom != idom_[b]) {
+        idom_[b] = idom;
+        changed = true;
+      }
+    }
+  }
+
+  /* a join is in the frontier of everything on the way up the tree from
+   * each of its predecessors to its immediate dominator */
+  frontier_.assign(order_.size(), {});
+  for (size_t b = 0; b < order_.size(); b++) {
+    if (order_[b]->predecessors().size() < 2) {
+      continue;
+    }
+    for (auto pred : order_[b]->predecessors()) {
+      for (size_t r = rank_[pred]; r != idom_[b]; r = idom_[r]) {
+        if (frontier_[r].empty() || frontier_[r].back() != b) {
+          frontier_[r].push_back(b);
+        }
+      }
+    }
+  }
+}
+
+void SSA::find_liveness(const BitSet &tracked, std::vector<BitSet> &live_in,
+                        std::vector<BitSet> &live_out) {
+  /* IRProc's liveness doesn't count the return value of a call as a
+   * definition, and a declaration is one to it */
+  size_t n = proc_->num_addresses();
+  auto is_tracked = [&](IRAddress *addr) {
+    return addr && tracked.contains(proc_->index(addr));
+  };
+  std::vector<BitSet> use(order_.size(), BitSet(n)),
+      def(order_.size(), BitSet(n));
+  for (size_t b = 0; b < order_.size(); b++) {
+    for (auto &instr : order_[b]->instrs()) {
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (is_tracked(addr) && !writes(instr, k) &&
+            !def[b].contains(proc_->index(addr))) {
+          use[b].insert(proc_->index(addr));
+        }
+      }
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (is_tracked(addr) && writes(instr, k) &&
+            instr.op() != IROp::ALLOC) {
+          def[b].insert(proc_->index(addr));
+        }
+      }
+    }
+  }
+
+  live_in.assign(order_.size(), BitSet(n));
+  live_out.assign(order_.size(), BitSet(n));
+  proc_->solve(IRProc::Direction::BACKWARD, [&](IRBlock *block) {
+    size_t b = rank_[block];
+    live_out[b].clear();
+    for (auto succ : block->successors()) {
+      live_out[b].unite(live_in[rank_[succ]]);
+    }
+    return live_in[b].assign_union_difference(use[b], live_out[b], def[b]);
+  });
+}
+
+void SSA::place_phis() {
+  /* blocks defining each candidate */
+  std::vector<std::vector<size_t>> def_blocks(proc_->num_addresses());
+  for (size_t b = 0; b < order_.size(); b++) {
+    for (auto &instr : order_[b]->instrs()) {
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (is_candidate(addr) && writes(instr, k) &&
+            instr.op() != IROp::ALLOC) {
+          auto &defs = def_blocks[proc_->index(addr)];
+          if (defs.empty() || defs.back() != b) {
+            defs.push_back(b);
+          }
+        }
+      }
+    }
+  }
+
+  /* last var each block got a phi for, or was queued for, plus one */
+  std::vector<size_t> has_phi(order_.size()), queued(order_.size());
+  candidates_.for_each([&](size_t v) {
+    auto work = def_blocks[v];
+    for (auto b : work) {
+      queued[b] = v + 1;
+    }
+    while (!work.empty()) {
+      size_t x = work.back();
+      work.pop_back();
+      for (auto y : frontier_[x]) {
+        if (has_phi[y] == v + 1 || !live_in_[y].contains(v)) {
+          continue;
+        }
+        has_phi[y] = v + 1;
+        auto block = order_[y];
+        auto var = proc_->address(v)->var();
+        block->phis_.push_back(
+            {var, var, std::vector<IRArg>(block->predecessors().size())});
+        phis_++;
+        if (queued[y] != v + 1) {
+          queued[y] = v + 1;
+          work.push_back(y);
+        }
+      }
+    }
+  });
+}
+
+IRVar *SSA::new_version(IRVar *var) {
+  size_t i = proc_->index(var);
+  original_of_.push_back(i < originals_ ? i : original_of_[i - originals_]);
+  auto &vars = proc_->vars_;
+  vars.emplace_back(var, ++versions_[var->id()]);
+  proc_->number(&vars.back());
+  return &vars.back();
+}
+
+size_t SSA::count_copies() {
+  size_t copies = 0;
+  for (auto &block : proc_->blocks()) {
+    for (auto &instr : block->instrs()) {
+      copies += instr.op() == IROp::COPY;
+    }
+  }
+  return copies;
+}
+
+void SSA::rename() {
+  /* versions of each candidate in scope, innermost last */
+  std::vector<std::vector<IRVar *>> stacks(proc_->num_addresses());
+  auto top = [&](IRVar *var) {
+    auto &stack = stacks[proc_->index(var)];
+    if (stack.empty()) {
+      read_originals_.insert(proc_->index(var));
+      return var;
+    }
+    return stack.back();
+  };
+  /* candidates pushed, in order, so leaving a block can pop its own */
+  std::vector<size_t> pushed;
+  auto define = [&](IRVar *var) {
+    size_t i = proc_->index(var);
+    auto version = new_version(var);
+    stacks[i].push_back(version);
+    pushed.push_back(i);
+    return version;
+  };
+
+  std::vector<std::vector<size_t>> children(order_.size());
+  for (size_t b = 1; b < order_.size(); b++) {
+    children[idom_[b]].push_back(b);
+  }
+
+  /* dominator tree preorder; a block is left once its subtree is done */
+  struct Visit {
+    size_t block;
+    size_t pushed;
+    size_t next_child;
+  };
+  std::vector<Visit> stack{{0, 0, 0}};
+  bool entered = false;
+  while (!stack.empty()) {
+    auto &visit = stack.back();
+    auto block = order_[visit.block];
+    if (!entered) {
+      visit.pushed = pushed.size();
+      for (auto &phi : block->phis_) {
+        phi.dest = define(phi.var);
+      }
+      for (auto &instr : block->instrs()) {
+        for (int k = 0; k < 3; k++) {
+          auto addr = instr.operand(k);
+          if (is_candidate(addr) && !writes(instr, k)) {
+            instr.set_arg(k, top(addr->var()));
+          }
+        }
+        /* params keep the original, declarations aren't definitions */
+        if (instr.op() == IROp::PALLOC || instr.op() == IROp::ALLOC) {
+          continue;
+        }
+        for (int k = 0; k < 3; k++) {
+          auto addr = instr.operand(k);
+          if (is_candidate(addr) && writes(instr, k)) {
+            instr.set_arg(k, define(addr->var()));
+          }
+        }
+      }
+      for (auto succ : block->successors()) {
+        auto &preds = succ->predecessors();
+        for (size_t j = 0; j < preds.size(); j++) {
+          if (preds[j] == block) {
+            for (auto &phi : succ->phis_) {
+              phi.args[j] = top(phi.var);
+            }
+          }
+        }
+      }
+    }
+
+    auto &children_of = children[visit.block];
+    if (visit.next_child < children_of.size()) {
+      stack.push_back({children_of[visit.next_child++], 0, 0});
+      entered = false;
+      continue;
+    }
+    while (pushed.size() > visit.pushed) {
+      stacks[pushed.back()].pop_back();
+      pushed.pop_back();
+    }
+    stack.pop_back();
+    entered = true;
+  }
+}
+
+void SSA::sequentialize(std::vector<std::pair<IRVar *, IRArg>> copies,
+                        std::vector<IRInstr> &out, int line) {
+  auto emit = [&](IRVar *dest, IRArg src) {
+    IRInstr copy(IROp::COPY, dest, src);
+    copy.set_source_line(line);
+    out.push_back(copy);
+  };
+
+  /* Boissinot et al.: loc is where the value a var had is now, pred the
+   * var a dest takes its value from. A dest no one still needs is ready to
+   * be written; when none is, the rest are cycles, one of which is broken
+   * by saving a dest in a temporary. Constants are read from nowhere, so
+   * they go last. */
+  std::unordered_map<IRVar *, IRVar *> loc, pred;
+  std::vector<IRVar *> ready, todo;
+  std::vector<std::pair<IRVar *, IRArg>> constants;
+  for (auto [dest, src] : copies) {
+    if (!src.is_var()) {
+      constants.push_back({dest, src});
+    } else if (src.var() != dest) {
+      loc[src.var()] = src.var();
+      pred[dest] = src.var();
+      todo.push_back(dest);
+    }
+  }
+  for (auto dest : todo) {
+    if (!loc.contains(dest)) {
+      ready.push_back(dest);
+    }
+  }
+  IRVar *temp = nullptr;
+  while (!todo.empty()) {
+    while (!ready.empty()) {
+      auto b = ready.back();
+      ready.pop_back();
+      auto a = pred[b];
+      auto c = loc[a];
+      emit(b, c);
+      loc[a] = b;
+      if (a == c && pred.contains(a)) {
+        ready.push_back(a);
+      }
+    }
+    auto b = todo.back();
+    todo.pop_back();
+    if (b != loc[pred[b]]) {
+      if (!temp) {
+        temp = new_version(b);
+      }
+      emit(temp, b);
+      loc[b] = temp;
+      ready.push_back(b);
+    }
+  }
+  for (auto [dest, src] : constants) {
+    emit(dest, src);
+  }
+}
+
+void SSA::destroy() {
+  if (!converted_) {
+    return;
+  }
+  /* counted now, so that copies a pass made in SSA form aren't counted */
+  copies_ = count_copies();
+  auto &blocks = proc_->blocks();
+  std::unordered_map<IRBlock *, size_t> position;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    position[blocks[i].get()] = i;
+  }
+  auto line_of = [](IRBlock *block, bool last) {
+    auto instrs = block->instrs();
+    return instrs.empty() ? 0
+                          : (last ? instrs.back() : instrs.front()).source_line();
+  };
+  auto successors = [](IRBlock *block) {
+    auto succ = block->successors();
+    std::sort(succ.begin(), succ.end());
+    return std::unique(succ.begin(), succ.end()) - succ.begin();
+  };
+
+  /* copies at the start and at the end of each block, and declarations
+   * to go before the latter */
+  std::vector<std::vector<IRInstr>> head(blocks.size()), tail(blocks.size()),
+      decls(blocks.size());
+  for (auto &block : blocks) {
+    auto &phis = block->phis_;
+    if (phis.empty()) {
+      continue;
+    }
+    auto &preds = block->predecessors();
+    /* the stack frame is laid out from where vars are first referenced,
+     * which has to come before all their other references, so what the
+     * predecessors write is declared in the block dominating them all */
+    auto idom = order_[idom_[rank_[block.get()]]];
+    auto declare = [&](IRVar *var) {
+      IRInstr decl(IROp::ALLOC, var);
+      decl.set_source_line(line_of(idom, true));
+      decls[position[idom]].push_back(decl);
+    };
+    bool shared = std::any_of(preds.begin(), preds.end(),
+                              [&](auto pred) { return successors(pred) > 1; });
+
+    std::vector<IRArg> temps;
+    if (shared) {
+      auto &copies = head[position[block.get()]];
+      for (auto &phi : phis) {
+        auto temp = new_version(phi.var);
+        temps.push_back(temp);
+        declare(temp);
+        sequentialize({{phi.dest, temp}}, copies, line_of(block.get(), false));
+      }
+    }
+    for (auto &phi : phis) {
+      declare(phi.dest);
+    }
+    for (size_t j = 0; j < preds.size(); j++) {
+      /* a predecessor can be in there twice, if it jumps to where it
+       * falls through */
+      if (std::find(preds.begin(), preds.begin() + j, preds[j]) !=
+          preds.begin() + j) {
+        continue;
+      }
+      std::vector<std::pair<IRVar *, IRArg>> copies;
+      for (size_t i = 0; i < phis.size(); i++) {
+        copies.push_back(
+            {shared ? temps[i].var() : phis[i].dest, phis[i].args[j]});
+      }
+      sequentialize(std::move(copies), tail[position[preds[j]]],
+                    line_of(preds[j], true));
+    }
+    phis.clear();
+  }
+
+  /* jumps read nothing the copies write, and the copies only move values,
+   * so putting them after the comparison a jump tests leaves the flags
+   * alone */
+  std::vector<std::vector<IRInstr>> instrs(blocks.size());
+  for (size_t i = 0; i < blocks.size(); i++) {
+    auto &out = instrs[i];
+    out = std::move(head[i]);
+    tail[i].insert(tail[i].begin(), decls[i].begin(), decls[i].end());
+    auto body = blocks[i]->instrs();
+    bool jump = !body.empty() && body.back().is_jump();
+    for (size_t k = 0; k < body.size(); k++) {
+      auto &instr = body[k];
+      if (jump && k == body.size() - 1) {
+        out.insert(out.end(), tail[i].begin(), tail[i].end());
+      }
+      out.push_back(instr);
+    }
+    if (!jump) {
+      out.insert(out.end(), tail[i].begin(), tail[i].end());
+    }
+  }
+  proc_->set_instrs(std::move(instrs));
+  coalesce();
+  size_t copies = count_copies();
+  copies_ = copies > copies_ ? copies - copies_ : 0;
+
+  /* the vars of the proc were counted when it was built */
+  for (auto &block : blocks) {
+    block->ref_.for_each([&](size_t i) {
+      if (i >= originals_) {
+        proc_->address(i)->var()->add_use();
+      }
+    });
+  }
+}
+
+void SSA::coalesce() {
+  auto &blocks = proc_->blocks();
+  size_t n = proc_->num_addresses();
+  auto original = [&](size_t i) {
+    return i < originals_ ? i : original_of_[i - originals_];
+  };
+  BitSet versions(n);
+  for (size_t i = 0; i < n; i++) {
+    if (candidates_.contains(original(i))) {
+      versions.insert(i);
+    }
+  }
+  std::vector<BitSet> live_in, live_out;
+  find_liveness(versions, live_in, live_out);
+
+  /* a var can stand for all its versions again unless two of them hold
+   * different values at once; a copy's source holds the same */
+  BitSet split(n);
+  for (size_t b = 0; b < order_.size(); b++) {
+    auto live = live_out[b];
+    auto instrs = order_[b]->instrs();
+    for (auto itr = instrs.rbegin(); itr != instrs.rend(); ++itr) {
+      auto &instr = *itr;
+      int src = instr.op() == IROp::COPY && instr.arg2().is_var()
+                    ? proc_->index(instr.arg2().addr())
+                    : -1;
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (!addr || !writes(instr, k) || instr.op() == IROp::ALLOC) {
+          continue;
+        }
+        size_t d = proc_->index(addr);
+        if (versions.contains(d)) {
+          live.for_each([&](size_t v) {
+            if (v != d && (int)v != src && original(v) == original(d)) {
+              split.insert(original(d));
+            }
+          });
+        }
+        live.erase(d);
+      }
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (addr && !writes(instr, k) && versions.contains(proc_->index(addr))) {
+          live.insert(proc_->index(addr));
+        }
+      }
+    }
+  }
+
+  /* the versions that are left are allocated where they are declared, the
+   * original only if it is still read */
+  std::vector<std::vector<IRInstr>> instrs(blocks.size());
+  for (size_t b = 0; b < blocks.size(); b++) {
+    for (auto instr : blocks[b]->instrs()) {
+      if (instr.op() == IROp::ALLOC &&
+          versions.contains(proc_->index(instr.arg1().addr()))) {
+        size_t i = proc_->index(instr.arg1().addr());
+        bool keep = split.contains(original(i))
+                        ? i >= originals_ || read_originals_.contains(i)
+                        : i < originals_;
+        if (!keep) {
+          continue;
+        }
+      }
+      for (int k = 0; k < 3; k++) {
+        auto addr = instr.operand(k);
+        if (addr && versions.contains(proc_->index(addr))) {
+          size_t o = original(proc_->index(addr));
+          if (!split.contains(o)) {
+            instr.set_arg(k, proc_->address(o)->var());
+          }
+        }
+      }
+      if (instr.op() == IROp::COPY && instr.arg2().is_addr() &&
+          instr.arg1().addr() == instr.arg2().addr()) {
+        continue;
+      }
+      instrs[b].push_back(instr);
+    }
+  }
+  proc_->set_instrs(std::move(instrs));
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bit_set.h"
+#include "ir_proc.h"
+
+/* SSA form of the scalar vars of a proc.
+ *
+ * Construction (Cytron et al.) finds the dominator tree (Cooper, Harvey
+ * and Kennedy's iterative algorithm) and dominance frontiers, places a phi
+ * for a var at the iterated dominance frontier of its definitions wherever
+ * the var is live (pruned SSA) and walks the dominator tree giving every
+ * definition a var of its own, %id.n. Phis are kept on the blocks, see
+ * IRBlock::phis. The original var stands for the value before any
+ * definition: the parameters, and whatever is read before being written.
+ * Arrays, vars whose address is taken and the results of comparisons,
+ * which are flags until a jump uses them, are left alone.
+ *
+ * Destruction turns the phis of a block into copies at the end of its
+ * predecessors. The copies of one edge happen all at once, so they are
+ * sequentialized, a cycle of them taking a temporary. A predecessor with
+ * another successor would run the copies on its way there as well, so the
+ * phis of a block with such a predecessor each get a temporary instead,
+ * which all the predecessors write and the block copies from on entry.
+ * Then every var whose versions never hold different values at once,
+ * which is all of them unless the code was changed in between, takes their
+ * place again and the copies between them go away.
+ *
+ * The proc must have its flow graph built and nothing else; its analyses
+ * run after destruction. */
+class SSA {
+public:
+  explicit SSA(IRProc *proc);
+
+  /* replace the phis with copies, leaving the proc out of SSA form */
+  void destroy();
+
+  /* false if the proc couldn't be put in SSA form, see converted_ */
+  bool converted() const { return converted_; }
+  /* the address with IRProc::index i is a version made here; until
+   * destroyed, those are the only vars with a single definition */
+  bool is_version(size_t i) const { return i >= originals_; }
+
+  /* operand k of instr is written, its other addresses are read; unlike
+   * IRInstr::dest this counts the return value of a call */
+  static bool writes(const IRInstr &instr, int k);
+
+  size_t phis() { return phis_; }
+  /* copies added, once destroyed */
+  size_t copies() { return copies_; }
+
+private:
+  void find_candidates();
+  void find_dominators();
+  /* liveness of the addresses in tracked, by rank */
+  void find_liveness(const BitSet &tracked, std::vector<BitSet> &live_in,
+                     std::vector<BitSet> &live_out);
+  void place_phis();
+  void rename();
+  /* puts a var back in place of its versions where they don't overlap */
+  void coalesce();
+  size_t count_copies();
+
+  /* a new version of var */
+  IRVar *new_version(IRVar *var);
+  /* appends to out the copies dest <- src, as if they all happened at
+   * once */
+  void sequentialize(std::vector<std::pair<IRVar *, IRArg>> copies,
+                     std::vector<IRInstr> &out, int line);
+
+  bool is_candidate(IRAddress *addr) {
+    return addr && addr->is_var() && candidates_.contains(proc_->index(addr));
+  }
+
+  IRProc *proc_;
+  /* addresses numbered before any version was made */
+  size_t originals_;
+  /* vars put in SSA form, by IRProc::index */
+  BitSet candidates_;
+  /* candidates read before any definition, by IRProc::index */
+  BitSet read_originals_;
+  /* false if the entry block has predecessors, which there is nowhere to
+   * put the copies for */
+  bool converted_ = false;
+
+  /* blocks in reverse postorder, and the position of each in it */
+  std::vector<IRBlock *> order_;
+  std::unordered_map<IRBlock *, size_t> rank_;
+  /* by rank */
+  std::vector<size_t> idom_;
+  std::vector<std::vector<size_t>> frontier_;
+  std::vector<BitSet> live_in_;
+
+  /* versions made of each var, by IRVar::id */
+  std::unordered_map<int, int> versions_;
+  /* index of the var each version is of, by index - originals_ */
+  std::vector<size_t> original_of_;
+
+  size_t phis_ = 0;
+  size_t copies_ = 0;
+};
@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <cstring>
+#include <fmt/core.h>
+#include <fstream>
+#include <iostream>
+
+#include "ir/ir_binary.h"
+#include "parse_utils.h"
+
+/* converts between textual (.ir) and binary (.irb) IR, direction is picked
+ * from the input */
+int main(int argc, char **argv) {
+  const char *in_file = nullptr;
+  const char *out_file = nullptr;
+  for (int i = 1; i < argc - 1; i++) {
+    if (std::strcmp(argv[i], "-i") == 0) {
+      in_file = argv[i + 1];
+    }
+    if (std::strcmp(argv[i], "-o") == 0) {
+      out_file = argv[i + 1];
+    }
+  }
+
+  if (!in_file) {
+    fmt::print(stderr, "usage: irconv -i <input.ir|input.irb> [-o output]\n");
+    return 1;
+  }
+
+  if (IRBinaryReader::is_binary(in_file)) {
+    auto out = out_file ? std::string(out_file)
+                        : std::string(base_name(in_file)) + ".ir";
+    std::ofstream out_stream(out);
+    if (!ir_binary_to_text(in_file, out_stream)) {
+      fmt::print(stderr, "Malformed binary IR: {}\n", in_file);
+      return 1;
+    }
+  } else {
+    std::ifstream in(in_file);
+    if (!in) {
+      fmt::print(stderr, "Couldn't access input file: {}\n", in_file);
+      return 1;
+    }
+    auto out = out_file ? std::string(out_file)
+                        : std::string(base_name(in_file)) + ".irb";
+    IRBinaryWriter writer;
+    if (!ir_text_to_binary(in, &writer) || !writer.write(out.c_str())) {
+      fmt::print(stderr, "Couldn't convert: {}\n", in_file);
+      return 1;
+    }
+  }
+}
@@ -2,76 +2,174 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <string>
 
+/* verbosity, a logger writes everything at or below its level */
+enum class LogLevel {
+  /* null sink */
+  OFF,
+  /* plain write/writeln */
+  INFO,
+  /* grammar rules matched by the parser */
+  DEBUG,
+  /* every token */
+  TRACE,
+};
+
+/* Output is collected in a user space buffer and only written out when it
+ * gets large, on flush() or on destruction, except on stderr where each
+ * line is flushed so diagnostics show up right away. */
 class Logger {
 
 public:
+  static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+  Logger() = default;
+  ~Logger() { close(); }
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
   /* set out put log file, default to stderr */
   void set_out_file(const char *path) {
-    if (out_file_ && out_file_ != stderr) {
-      std::fclose(out_file_);
-    }
+    close();
     out_file_ = std::fopen(path, "w");
     if (!out_file_) {
       out_file_ = stderr;
       write("[ERROR]\tFailed to change log output file. File doesn't exist or "
             "isn't accessible.");
+      flush();
     }
   }
 
+  /* like set_out_file, but the file is only created once something is
+   * written, so a clean run leaves nothing behind */
+  void set_out_file_lazy(const char *path) {
+    close();
+    lazy_path_ = path;
+  }
+
+  void set_level(LogLevel level) { level_ = level; }
+  LogLevel level() const { return level_; }
+
+  /* whether writes at this level go anywhere */
+  bool enabled(LogLevel level = LogLevel::INFO) const {
+    return level <= level_;
+  }
+
+  /* drop everything written from now on */
+  void disable() {
+    close();
+    level_ = LogLevel::OFF;
+  }
+
   /* Write formatted string to log */
   template <class... T>
   void write(fmt::format_string<T...> fmt_string, T &&...args) {
-    init();
-    fmt::print(out_file_, fmt_string, std::forward<decltype(args)>(args)...);
+    if (!enabled()) {
+      return;
+    }
+    fmt::format_to(fmt::appender(buffer_), fmt_string,
+                   std::forward<decltype(args)>(args)...);
+    spill();
+  }
+
+  /* Write formatted string to log if level is enabled */
+  template <class... T>
+  void write(LogLevel level, fmt::format_string<T...> fmt_string,
+             T &&...args) {
+    if (!enabled(level)) {
+      return;
+    }
+    fmt::format_to(fmt::appender(buffer_), fmt_string,
+                   std::forward<decltype(args)>(args)...);
+    spill();
   }
 
   /* Write plain string to log */
   void write(const char *s) {
-    init();
-    std::fputs(s, out_file_);
+    if (!enabled()) {
+      return;
+    }
+    buffer_.append(s, s + std::strlen(s));
+    spill();
   }
 
   /* Write formatted string to log and end line */
   template <class... T>
   void writeln(fmt::format_string<T...> fmt_string, T &&...args) {
-    init();
-    fmt::print(out_file_, fmt_string, std::forward<decltype(args)>(args)...);
+    write(fmt_string, std::forward<decltype(args)>(args)...);
     endl();
   }
 
   /* Write plain string to log and end line */
   void writeln(const char *s) {
-    init();
-    std::fputs(s, out_file_);
+    write(s);
     endl();
   }
 
-  /* End current line and flush */
+  /* End current line */
   void endl() {
-    init();
-    std::fputc('\n', out_file_);
-    flush();
+    if (!enabled()) {
+      return;
+    }
+    buffer_.push_back('\n');
+    if (out_file_ == stderr) {
+      flush();
+    } else {
+      spill();
+    }
   }
 
-  /* flush file buffer to output */
+  /* flush buffer to output */
   void flush() {
-    init();
+    if (!out_file_) {
+      out_file_ = stderr;
+    }
+    if (buffer_.size()) {
+      if (!lazy_path_.empty()) {
+        open_lazy();
+      }
+      std::fwrite(buffer_.data(), 1, buffer_.size(), out_file_);
+      buffer_.clear();
+    }
     std::fflush(out_file_);
   }
 
 private:
-  void init() {
-    if (!out_file_) {
-      out_file_ = stderr;
+  void spill() {
+    if (buffer_.size() >= BUFFER_SIZE) {
+      flush();
+    }
+  }
+
+  void close() {
+    flush();
+    if (out_file_ != stderr) {
+      std::fclose(out_file_);
+    }
+    out_file_ = stderr;
+    lazy_path_.clear();
+  }
+
+  /* stays on stderr if the file can't be created */
+  void open_lazy() {
+    if (auto file = std::fopen(lazy_path_.c_str(), "w")) {
+      out_file_ = file;
     }
+    lazy_path_.clear();
   }
 
   std::FILE *out_file_ = stderr;
+  LogLevel level_ = LogLevel::TRACE;
+  fmt::memory_buffer buffer_;
+  /* file to open on the first write, see set_out_file_lazy */
+  std::string lazy_path_;
 };
@@ -7,6 +7,7 @@
 
 %code requires{
 
+#include <charconv>
 #include <cstdio>
 #include <cstdarg>
 #include <token.h>
@@ -51,8 +52,6 @@ void lyyerror(YYLTYPE t, char *s, ...);
 %type <non_term> term unary_expression factor variable argument_list arguments 
 
 
-%destructor { delete $$; } <non_term>
-%destructor { delete $$; } <token>
 
 /* precedence rules */
 
@@ -104,7 +103,7 @@ unit : var_declaration {
         $$->decls().push_back(std::move($1->decl()));
      } 
      | error {
-        $$ = NonTerminal::create(context, @$, "unit", NonTerminal::error(@1));
+        $$ = NonTerminal::create(context, @$, "unit", NonTerminal::error(context, @1));
         context->report_syntax_error(@$, "Syntax error at unit declaration");
         $$->ast = Decls{};
      }
@@ -114,7 +113,7 @@ func_declaration : type_specifier ID LPAREN parameter_list RPAREN SEMICOLON {
         $$ = NonTerminal::create(context, @$, "func_declaration", $1, $2, $3, $4, $5, $6);
         $$->ast = FuncDecl::create(context, @$, $1->type(),
                                     std::move($4->paramdecls()),
-                                    $2->value());
+                                    std::string($2->value()));
         
         /* no declaration to follow */
         context->current_params(nullptr);
@@ -123,7 +122,7 @@ func_declaration : type_specifier ID LPAREN parameter_list RPAREN SEMICOLON {
         $$ = NonTerminal::create(context, @$, "func_declaration", $1, $2, $3, $4, $5);
         $$->ast = FuncDecl::create(context, @$, $1->type(), 
                                     ParamDecls(),
-                                    $2->value());
+                                    std::string($2->value()));
         /* no declaration to follow */
         context->current_params(nullptr);
     }
@@ -131,14 +130,14 @@ func_declaration : type_specifier ID LPAREN parameter_list RPAREN SEMICOLON {
 		 
 func_definition : type_specifier ID LPAREN parameter_list RPAREN {
 			context->current_func(FuncDecl::create(context, @1, $1->type(), 
-                                    std::move($4->paramdecls()), $2->value()));
+                                    std::move($4->paramdecls()), std::string($2->value())));
 		} compound_statement {
         	$$ = NonTerminal::create(context, @$, "func_definition", $1, $2, $3, $4, $5, $7);
 			$$->ast = context->define_current_func(std::move($7->stmt()));
     	}
 		| type_specifier ID LPAREN RPAREN {
 			context->current_func(FuncDecl::create(context, @1, $1->type(), 
-                                    ParamDecls(), $2->value()));			
+                                    ParamDecls(), std::string($2->value())));			
 		} compound_statement {
         	$$ = NonTerminal::create(context, @$, "func_definition", $1, $2, $3, $4, $6);
 			$$->ast = context->define_current_func(std::move($6->stmt()));
@@ -150,7 +149,7 @@ parameter_list  : parameter_list COMMA type_specifier ID {
 	        $$ = NonTerminal::create(context, @$, "parameter_list", $1, $2, $3, $4);
 	        $$->ast = std::move($1->ast);
 	        $$->paramdecls().push_back(ParamDecl::create(context, @$, $3->type(), 
-	                                      $4->value()));
+	                                      std::string($4->value())));
 	        context->current_params(&$$->paramdecls());
     	}
 		| parameter_list COMMA type_specifier {
@@ -162,7 +161,7 @@ parameter_list  : parameter_list COMMA type_specifier ID {
  		| type_specifier ID {
 	        $$ = NonTerminal::create(context, @$, "parameter_list", $1, $2);
 	        $$->ast = ParamDecls();
-	        $$->paramdecls().push_back(ParamDecl::create(context, @$, $1->type(), $2->value()));
+	        $$->paramdecls().push_back(ParamDecl::create(context, @$, $1->type(), std::string($2->value())));
 	        context->current_params(&$$->paramdecls());
     	}
 		| type_specifier {
@@ -172,14 +171,14 @@ parameter_list  : parameter_list COMMA type_specifier ID {
 	        context->current_params(&$$->paramdecls());
     	}
  		| parameter_list error {
-        $$ = NonTerminal::create(context, @$, "parameter_list", $1, NonTerminal::error(@2));
+        $$ = NonTerminal::create(context, @$, "parameter_list", $1, NonTerminal::error(context, @2));
         $$->ast = std::move($1->ast);
 	      context->current_params(&$$->paramdecls());
         context->report_syntax_error(@2, "Syntax error at parameter list of function declaration");
         
     } 
     | error {
-        $$ = NonTerminal::create(context, @$, "parameter_list", NonTerminal::error(@1));
+        $$ = NonTerminal::create(context, @$, "parameter_list", NonTerminal::error(context, @1));
         $$->ast = ParamDecls{};
         context->report_syntax_error(@1, "Syntax error at parameter list of function declaration");
     }
@@ -227,39 +226,43 @@ declaration_list : declaration_list COMMA ID {
           $$ = NonTerminal::create(context, @$, "declaration_list", $1, $2, $3);
           $$->ast = std::move($1->ast);
           $$->vardecls().push_back(
-              VarDecl::create(context, @3, context->current_type(), $3->value())
+              VarDecl::create(context, @3, context->current_type(), std::string($3->value()))
           );
       }
  		  | declaration_list COMMA ID LSQUARE CONST_INT RSQUARE {
           $$ = NonTerminal::create(context, @$, "declaration_list", $1, $2, $3, $4, $5, $6);
-          size_t size = std::atoi($5->value().c_str());
+          size_t size = 0;
+          std::from_chars($5->value().data(),
+                          $5->value().data() + $5->value().size(), size);
           auto type = context->current_type()->array_type()->sized_array(size);
           $$->ast = std::move($1->ast);
           $$->vardecls().push_back(
-              VarDecl::create(context, @3, type, $3->value()));
+              VarDecl::create(context, @3, type, std::string($3->value())));
       }
  		  | ID {
           $$ = NonTerminal::create(context, @$, "declaration_list", $1);
           $$->ast = VarDecls{};
           $$->vardecls().push_back(
-              VarDecl::create(context, @$, context->current_type(), $1->value()));
+              VarDecl::create(context, @$, context->current_type(), std::string($1->value())));
       }
  		  | ID LSQUARE CONST_INT RSQUARE {
           $$ = NonTerminal::create(context, @$, "declaration_list", $1, $2, $3, $4);
           $$->ast = VarDecls{};
-          size_t size = std::atoi($3->value().c_str());
+          size_t size = 0;
+          std::from_chars($3->value().data(),
+                          $3->value().data() + $3->value().size(), size);
           auto type = context->current_type()->sized_array(size);
           $$->vardecls().push_back(
-              VarDecl::create(context, @3, type, $1->value()));
+              VarDecl::create(context, @3, type, std::string($1->value())));
       }
       | declaration_list error {
-          $$ = NonTerminal::create(context, @$, "declaration_list", $1, NonTerminal::error(@2));
+          $$ = NonTerminal::create(context, @$, "declaration_list", $1, NonTerminal::error(context, @2));
           $$->ast = std::move($1->ast);
           context->report_syntax_error(@2, "Syntax error at declaration list of variable declaration");
           
       }
       | error {
-          $$ = NonTerminal::create(context, @$, "declaration_list", NonTerminal::error(@1));
+          $$ = NonTerminal::create(context, @$, "declaration_list", NonTerminal::error(context, @1));
           $$->ast = VarDecls{};
           context->report_syntax_error(@1, "Syntax error at declaration list of variable declaration");
           
@@ -281,12 +284,12 @@ statements : statement {
           $$->ast = std::move($1->ast);
       }
       | statements error SEMICOLON {
-          $$ = NonTerminal::create(context, @$, "statements", $1, NonTerminal::error(@1), $3);
+          $$ = NonTerminal::create(context, @$, "statements", $1, NonTerminal::error(context, @1), $3);
           $$->ast = std::move($1->ast);
           context->report_syntax_error(@2, "Syntax error at expression of expression statement");
       }
       | error SEMICOLON {
-          $$ = NonTerminal::create(context, @$, "statements", NonTerminal::error(@1), $2);
+          $$ = NonTerminal::create(context, @$, "statements", NonTerminal::error(context, @1), $2);
           $$->ast = Stmts{};
           context->report_syntax_error(@1, "Syntax error at expression of expression statement");       
       }
@@ -482,12 +485,12 @@ arguments : arguments COMMA logic_expression {
             $$->exprs().push_back(std::move($1->expr()));
         }
         | arguments error {
-            $$ = NonTerminal::create(context, @$, "arguments", $1, NonTerminal::error(@2));
+            $$ = NonTerminal::create(context, @$, "arguments", $1, NonTerminal::error(context, @2));
             $$->ast = std::move($1->ast);
             context->report_syntax_error(@2, "Syntax error at argument list of call expression");            
         }
         | error {
-            $$ = NonTerminal::create(context, @$, "arguments", NonTerminal::error(@1));
+            $$ = NonTerminal::create(context, @$, "arguments", NonTerminal::error(context, @1));
             $$->ast = Exprs{};
             context->report_syntax_error(@1, "Syntax error at argument list of call expression");            
         }
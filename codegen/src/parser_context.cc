@@ -8,45 +8,64 @@
 
 #include <parser.tab.h>
 
-ParserContext::ParserContext(FILE *input)
-    : error_count_(0), table_(10, &logger_), in_file_(input) {
+ParserContext::ParserContext(FILE *input, bool use_arena,
+                             SymbolTable::Mode table_mode)
+    : arena_(use_arena), error_count_(0), in_file_(input),
+      table_(10, &logger_, table_mode) {
+  init_scanner();
+}
+
+ParserContext::ParserContext(std::unique_ptr<SourceBuffer> source,
+                             std::string_view prelude, bool use_arena,
+                             SymbolTable::Mode table_mode)
+    : source_(std::move(source)), arena_(use_arena), error_count_(0),
+      table_(10, &logger_, table_mode) {
+  if (!prelude.empty()) {
+    prelude_.reserve(prelude.size() + 2);
+    prelude_.append(prelude);
+    prelude_.append(2, '\0');
+  }
   init_scanner();
 }
 
 ParserContext::~ParserContext() { finish(); }
 
-Token *ParserContext::new_token(int lineno, const char *text,
+/* Text of plain tokens is used as is when it lies in the mapped source or
+ * the prelude, only flex's own read buffer (FILE input) needs a copy. */
+Token *ParserContext::new_token(int lineno, std::string_view text,
                                 Token::Type type) {
-  std::string val;
-  std::string_view lexeme;
+  std::string_view lexeme = text;
+  std::string_view val;
   int line = lineno;
 
   switch (type) {
   case COMMENT:
   case MULTI_LINE_COMMENT:
     line = start_line_;
-    val = lexeme = buf_;
+    val = lexeme = arena_.copy_string(buf_);
     break;
   case CONST_CHAR:
-    val = lexeme = buf_ = unescape_unquote(text);
+    val = lexeme = arena_.copy_string(unescape_unquote(text));
     break;
   case STRING:
-    lexeme = text;
-    val = unescape_unquote(text);
+    val = arena_.copy_string(unescape_unquote(text));
     break;
   case MULTI_LINE_STRING:
     line = start_line_;
     lexeme = buf_;
-    val = unescape_unquote(buf_);
+    val = arena_.copy_string(unescape_unquote(buf_));
     break;
   default:
-    val = lexeme = text;
+    /* ids are interned below */
+    val = source_ || type == ID ? text : arena_.copy_string(text);
     break;
   }
 
-  Token *token = new Token(lineno, type, std::move(val));
-  logger_.write("Line# {}: Token <{}> Lexeme {} found\n", line,
-                token->type_str(), lexeme);
+  Token *token = type == ID
+                     ? arena_.create<Token>(lineno, type, Interner::intern(val))
+                     : arena_.create<Token>(lineno, type, val);
+  logger_.write(LogLevel::TRACE, "Line# {}: Token <{}> Lexeme {} found\n",
+                line, token->type_str(), lexeme);
 
   buf_.clear();
   return token;
@@ -122,7 +141,7 @@ Type *ParserContext::get_base_type(Token *token) {
     built_in = BuiltInTypeName::DOUBLE;
     break;
   case ID: {
-    auto symbol = table_.look_up(token->value());
+    auto symbol = table_.look_up(token->name());
 
     if (symbol->type() == SymbolType::TYPE) {
       auto type = dynamic_cast<Type *>(symbol->decl());
@@ -160,6 +179,10 @@ bool ParserContext::insert_symbol(std::string_view name, SymbolType type,
   table_.insert(name, type, decl);
   return true;
 }
+bool ParserContext::insert_global_symbol(std::string_view name,
+                                         SymbolType type, Decl *decl) {
+  return table_.insert_global(Interner::intern(name), type, decl);
+}
 SymbolInfo *ParserContext::lookup_symbol(std::string_view name) {
   return table_.look_up(name);
 }
@@ -171,15 +194,58 @@ Decl *ParserContext::lookup_decl(std::string_view name) {
 
   return nullptr;
 }
+Decl *ParserContext::lookup_decl(Name name) {
+  auto symbol = table_.look_up(name);
+  if (symbol) {
+    return symbol->decl();
+  }
+
+  return nullptr;
+}
 
-void ParserContext::parse() { yyparse(scanner_, this); }
+void ParserContext::parse() {
+  auto prev = Arena::set_current(&arena_);
+  yyparse(scanner_, this);
+  Arena::set_current(prev);
+}
 
 void ParserContext::print_ast() {
+  if (!ast_logger_.enabled()) {
+    return;
+  }
   ASTPrinter printer(this);
   printer.print(ast_root_.get());
 }
 
-void ParserContext::print_pt() { pt_root_->print(this, 0); }
+void ParserContext::retire_non_terminal(NonTerminal *node) {
+  retired_non_terminals_.push_back(node);
+}
+
+/* Nodes retired by earlier actions are dead now. One whose AST wasn't moved
+ * on is left alone, so that it's still destroyed last, with the arena. */
+NonTerminal *ParserContext::recycled_non_terminal() {
+  if (build_pt_) {
+    return nullptr;
+  }
+  for (auto node : retired_non_terminals_) {
+    if (!node->owns_ast()) {
+      free_non_terminals_.push_back(node);
+    }
+  }
+  retired_non_terminals_.clear();
+  if (free_non_terminals_.empty()) {
+    return nullptr;
+  }
+  auto node = free_non_terminals_.back();
+  free_non_terminals_.pop_back();
+  return node;
+}
+
+void ParserContext::print_pt() {
+  if (build_pt_ && pt_root_ && pt_logger_.enabled()) {
+    pt_root_->print(this, 0);
+  }
+}
 
 std::unique_ptr<FuncDecl>
 ParserContext::define_current_func(std::unique_ptr<Stmt> def) {
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "arena.h"
 #include "ast/decl.h"
 #include "ast/type.h"
 #include "location.h"
 #include <array>
 #include <parse_utils.h>
 #include <pt/pt_node.h>
+#include <source_buffer.h>
 #include <string>
 #include <string_view>
 #include <symbol_table.h>
@@ -16,14 +18,28 @@ public:
   /* word size */
   int word_size = 16;
 
-  ParserContext(FILE *input);
+  /* tokens, parse tree and ast nodes come from a per context arena,
+   * use_arena = false falls back to one heap block per node */
+  ParserContext(FILE *input, bool use_arena = true,
+                SymbolTable::Mode table_mode = SymbolTable::Mode::FLAT);
+  /* scan a mapped source without copying it, tokens point into the mapping.
+   * prelude is scanned first, as if it preceded the source. */
+  ParserContext(std::unique_ptr<SourceBuffer> source,
+                std::string_view prelude = "", bool use_arena = true,
+                SymbolTable::Mode table_mode = SymbolTable::Mode::FLAT);
   ~ParserContext();
 
+  Arena *arena() { return &arena_; }
+
   void *scanner() { return scanner_; }
 
   void append_buf(std::string_view str);
 
-  Token *new_token(int lineno, const char *text, Token::Type type);
+  Token *new_token(int lineno, std::string_view text, Token::Type type);
+
+  /* switch the scanner from the prelude to the source, false once the
+   * source is done */
+  bool next_input();
 
   void report_error(int lineno, const char *text, const char *error_type);
 
@@ -37,13 +53,12 @@ public:
   template <class... T>
   void report_syntax_error(Location loc, fmt::format_string<T...> fmt_string,
                            T &&...args) {
-    static int last_line = -1;
     // don't print multiple errors on same line
-    if (last_line != loc.start_line()) {
+    if (last_syntax_error_line_ != loc.start_line()) {
       error_logger_.write("Line #{}: ", loc.start_line());
       error_logger_.writeln(fmt_string, std::forward<decltype(args)>(args)...);
       error_count_++;
-      last_line = loc.start_line();
+      last_syntax_error_line_ = loc.start_line();
     }
   }
 
@@ -79,14 +94,20 @@ public:
   Type *get_built_in_type(BuiltInTypeName type);
 
   bool insert_symbol(std::string_view name, SymbolType type, Decl *decl);
+  bool insert_global_symbol(std::string_view name, SymbolType type,
+                            Decl *decl);
   SymbolInfo *lookup_symbol(std::string_view name);
   Decl *lookup_decl(std::string_view name);
+  Decl *lookup_decl(Name name);
 
   Logger *logger() { return &logger_; }
   Logger *ast_logger() { return &ast_logger_; }
   Logger *pt_logger() { return &pt_logger_; }
   Logger *error_logger() { return &error_logger_; }
 
+  /* errors and warnings reported so far */
+  int error_count() const { return error_count_; }
+
   void set_logger_file(const char *path) { logger_.set_out_file(path); }
   void set_ast_logger_file(const char *path) { ast_logger_.set_out_file(path); }
   void set_pt_logger_file(const char *path) { pt_logger_.set_out_file(path); }
@@ -112,8 +133,16 @@ public:
     ast_root_ = std::move(root);
   }
 
-  PTNode *pt_root() { return pt_root_.get(); }
-  void set_pt_root(PTNode *root) { pt_root_ = std::unique_ptr<PTNode>(root); }
+  PTNode *pt_root() { return pt_root_; }
+  void set_pt_root(PTNode *root) { pt_root_ = root; }
+
+  /* Without a parse tree, grammar actions only use NonTerminals to pass the
+   * AST along. Nodes retired as children of one action can be reused from
+   * the next one on. */
+  bool build_pt() { return build_pt_; }
+  void build_pt(bool build) { build_pt_ = build; }
+  void retire_non_terminal(NonTerminal *node);
+  NonTerminal *recycled_non_terminal();
 
   void parse();
 
@@ -126,15 +155,27 @@ private:
   void init_scanner();
   void finish_scanner();
 
+  /* tokens point into these */
+  std::unique_ptr<SourceBuffer> source_;
+  /* followed by the two NULs flex needs */
+  std::string prelude_;
+
+  /* must outlive everything allocated from it */
+  Arena arena_;
+
   std::string buf_;
   int error_count_;
+  int last_syntax_error_line_ = -1;
   // location info
   int start_line_ = 1;
   int start_col_ = 1;
   int column_ = 1;
 
   void *scanner_;
-  FILE *in_file_;
+  FILE *in_file_ = nullptr;
+  /* flex buffers over source_ and prelude_ */
+  void *source_buffer_ = nullptr;
+  void *prelude_buffer_ = nullptr;
 
   /* loggers */
   Logger logger_;
@@ -154,5 +195,9 @@ private:
   Type *current_type_;
 
   std::unique_ptr<TranslationUnitDecl> ast_root_;
-  std::unique_ptr<PTNode> pt_root_;
+  PTNode *pt_root_ = nullptr;
+
+  bool build_pt_ = false;
+  std::vector<NonTerminal *> retired_non_terminals_;
+  std::vector<NonTerminal *> free_non_terminals_;
 };
@@ -9,14 +9,61 @@ Terminal::Terminal(Token *token) : token_(token), PTNode(token->type_str()) {}
 NonTerminal::NonTerminal(Location loc, std::string_view name)
     : PTNode(name), location_(loc) {}
 
+NonTerminal *NonTerminal::alloc(ParserContext *context, Location location,
+                                std::string_view name) {
+  if (auto node = context->recycled_non_terminal()) {
+    std::destroy_at(node);
+    return new (node) NonTerminal(location, name);
+  }
+  return context->arena()->create<NonTerminal>(location, name);
+}
+
+bool NonTerminal::build_pt(ParserContext *context) {
+  return context->build_pt();
+}
+
+void NonTerminal::retire(ParserContext *context, NonTerminal *node) {
+  context->retire_non_terminal(node);
+}
+
+Logger *NonTerminal::rule_logger(ParserContext *context) {
+  auto logger = context->logger();
+  return logger->enabled(LogLevel::DEBUG) ? logger : nullptr;
+}
+
+bool NonTerminal::owns_ast() {
+  return std::visit(
+      [](auto &value) {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_pointer_v<T>) {
+          /* Type * isn't owned */
+          return false;
+        } else if constexpr (requires { value.empty(); }) {
+          return !value.empty();
+        } else {
+          return value != nullptr;
+        }
+      },
+      ast);
+}
+
 void NonTerminal::add_child(PTNode *child) {
-  children_.push_back(std::unique_ptr<PTNode>(child));
+  if (last_child_) {
+    last_child_->next_sibling_ = child;
+  } else {
+    first_child_ = child;
+  }
+  last_child_ = child;
+}
+
+void NonTerminal::add_child(ParserContext *context, Token *token) {
+  add_child(context->arena()->create<Terminal>(token));
 }
 
 void NonTerminal::print_rule(Logger *logger, bool newline) {
   logger->write("{}", name());
   logger->write(" :");
-  for (auto &child : children_) {
+  for (auto child = first_child_; child; child = child->next_sibling()) {
     logger->write(" ");
     logger->write("{}", child->name());
   }
@@ -25,37 +72,31 @@ void NonTerminal::print_rule(Logger *logger, bool newline) {
   }
 }
 
+/* rules go to log.txt at debug verbosity */
 void NonTerminal::print_rule(ParserContext *context, bool newline) {
-  print_rule(context->logger(), newline);
+  if (auto logger = rule_logger(context)) {
+    print_rule(logger, newline);
+  }
 }
 
 void NonTerminal::print(ParserContext *context, int depth) {
   auto logger = context->pt_logger();
-  for (int i = 0; i < depth; i++) {
-    logger->write(" ");
-  }
+  logger->write("{:{}}", "", depth);
   print_rule(logger, false);
   logger->writeln("\t<Line: {}-{}>", location().start_line(),
                   location().end_line());
-  for (auto &child : children_) {
+  for (auto child = first_child_; child; child = child->next_sibling()) {
     child->print(context, depth + 1);
   }
 }
 
 void Terminal::print(ParserContext *context, int depth) {
   auto logger = context->pt_logger();
-  for (int i = 0; i < depth; i++) {
-    logger->write(" ");
-  }
+  logger->write("{:{}}", "", depth);
   logger->write("{} : {}", token_->type_str(), token_->value());
   logger->writeln("\t<Line: {}>", token_->line());
 }
 
-NonTerminal::~NonTerminal() {}
-
-Terminal::~Terminal() { delete token_; }
-
-NonTerminal *NonTerminal::error(Location location) {
-  NonTerminal *ret = new NonTerminal(location, "error");
-  return ret;
+NonTerminal *NonTerminal::error(ParserContext *context, Location location) {
+  return alloc(context, location, "error");
 }
@@ -24,22 +24,29 @@ using ParamDecls = std::vector<std::unique_ptr<ParamDecl>>;
 using Exprs = std::vector<std::unique_ptr<Expr>>;
 using Decls = std::vector<std::unique_ptr<Decl>>;
 
+/* parse tree nodes are owned by the ParserContext arena */
 class PTNode {
+  friend class NonTerminal;
+
 public:
   PTNode(std::string_view name);
-  virtual ~PTNode() = default;
 
   virtual void print(ParserContext *context, int depth) = 0;
   std::string_view name() { return name_; }
 
+  PTNode *next_sibling() { return next_sibling_; }
+
+protected:
+  ~PTNode() = default;
+
 private:
   std::string_view name_;
+  PTNode *next_sibling_ = nullptr;
 };
 
 class Terminal : public PTNode {
 public:
   Terminal(Token *token);
-  ~Terminal();
   void print(ParserContext *context, int depth) override;
 
 private:
@@ -49,21 +56,25 @@ private:
 class NonTerminal : public PTNode {
 public:
   NonTerminal(Location loc, std::string_view name);
-  ~NonTerminal();
 
   static NonTerminal *create(ParserContext *context, Location location,
                              std::string_view name, auto &&...child);
 
-  static NonTerminal *error(Location loc);
+  static NonTerminal *error(ParserContext *context, Location loc);
 
   void print(ParserContext *context, int depth) override;
 
   void add_child(PTNode *child);
-  void add_children(auto &&child, auto &&...other);
+  void add_child(ParserContext *context, Token *token);
+  void add_children(ParserContext *context, auto &&child, auto &&...other);
 
   void print_rule(ParserContext *context, bool newline = false);
   void print_rule(Logger *logger, bool newline = false);
 
+  /* whether ast still owns something, i.e. the grammar action didn't move it
+   * on */
+  bool owns_ast();
+
   Type *type() {
     assert(std::holds_alternative<Type *>(ast));
     return std::get<Type *>(ast);
@@ -117,27 +128,71 @@ public:
   Location &location() { return location_; }
 
 private:
-  std::vector<std::unique_ptr<PTNode>> children_;
+  static NonTerminal *alloc(ParserContext *context, Location location,
+                            std::string_view name);
+
+  /* ParserContext is incomplete here */
+  static bool build_pt(ParserContext *context);
+  static void retire(ParserContext *context, NonTerminal *node);
+  /* log.txt if grammar rules are logged, null otherwise */
+  static Logger *rule_logger(ParserContext *context);
+
+  /* rule line for log.txt without a linked parse tree */
+  static void log_rule(ParserContext *context, std::string_view name,
+                       auto &&...children);
+  static std::string_view child_name(Token *token) {
+    return token->type_str();
+  }
+  static std::string_view child_name(PTNode *node) { return node->name(); }
+
+  PTNode *first_child_ = nullptr;
+  PTNode *last_child_ = nullptr;
   Location location_;
 };
 
+/* Without a parse tree the node only carries the AST out of the grammar
+ * action; the child nodes are handed back for reuse. */
 NonTerminal *NonTerminal::create(ParserContext *context, Location location,
                                  std::string_view name, auto &&...children) {
-  NonTerminal *ret = new NonTerminal(location, name);
+  NonTerminal *ret = alloc(context, location, name);
+  if (!build_pt(context)) {
+    if constexpr (sizeof...(children) > 0) {
+      auto retire_child = [context](auto &&child) {
+        if constexpr (std::convertible_to<decltype(child), NonTerminal *>) {
+          retire(context, child);
+        }
+      };
+      (retire_child(children), ...);
+    }
+    log_rule(context, name, children...);
+    return ret;
+  }
   if constexpr (sizeof...(children) > 0) {
-    ret->add_children(std::forward<decltype(children)>(children)...);
+    ret->add_children(context, std::forward<decltype(children)>(children)...);
   }
   ret->print_rule(context, true);
   return ret;
 }
 
-void NonTerminal::add_children(auto &&child, auto &&...other) {
+void NonTerminal::add_children(ParserContext *context, auto &&child,
+                               auto &&...other) {
   if constexpr (std::convertible_to<decltype(child), Token *>) {
-    add_child(new Terminal(child));
+    add_child(context, child);
   } else {
     add_child(child);
   }
   if constexpr (sizeof...(other) > 0) {
-    add_children(std::forward<decltype(other)>(other)...);
+    add_children(context, std::forward<decltype(other)>(other)...);
+  }
+}
+
+void NonTerminal::log_rule(ParserContext *context, std::string_view name,
+                           auto &&...children) {
+  auto logger = rule_logger(context);
+  if (!logger) {
+    return;
   }
+  logger->write("{} :", name);
+  ((logger->write(" {}", child_name(children))), ...);
+  logger->endl();
 }
@@ -1,109 +1,230 @@
 #include "scope_table.h"
 #include <fstream>
 
+/* smallest power of two with room for num_buckets symbols below the maximum
+ * load factor */
+static size_t initial_capacity(size_t num_buckets) {
+  size_t capacity = 8;
+  while (capacity * 3 < num_buckets * 4) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
 /* Use allocators instead of new for flexibility */
-ScopeTable::ScopeTable(size_t num_buckets, ScopeTable *parent)
-    : id_(last_id_++), num_buckets_(num_buckets), parent_scope_(parent) {
-  table_ = allocator_.allocate(num_buckets);
-  /* initialise buckets to nullptr */
-  std::fill(table_, table_ + num_buckets, nullptr);
+ScopeTable::ScopeTable(size_t num_buckets, ScopeTable *parent, size_t id)
+    : id_(id), capacity_(initial_capacity(num_buckets)),
+      num_buckets_(num_buckets), parent_scope_(parent) {
+  slots_ = allocator_.allocate(capacity_);
+  std::uninitialized_default_construct_n(slots_, capacity_);
   // Log::writeln("\tScopeTable# {} created", id_);
 }
 
+/* slots (and the symbols in them) are trivially destructible */
 ScopeTable::~ScopeTable() {
-  for (size_t i = 0; i < num_buckets_; i++) {
-    for (SymbolInfo *p = table_[i], *t; p;) {
-      t = p, p = p->next();
-      std::destroy_at(t);
-      symbol_allocator_.deallocate(t, 1);
-    }
-  }
-  allocator_.deallocate(table_, num_buckets_);
+  allocator_.deallocate(slots_, capacity_);
   // Log::writeln("\tScopeTable# {} removed", id_);
 }
 
-/* Returns hash, position of node, previous pointer and current pointer (w.r.t
- * to found node) */
-std::tuple<size_t, size_t, SymbolInfo *, SymbolInfo *>
-ScopeTable::find_helper(std::string_view name) {
-  size_t h = sdbm_hash(name, num_buckets_);
-  size_t idx = 0;
-  SymbolInfo *curr = table_[h], *prev = nullptr;
-
-  for (; curr; prev = curr, curr = curr->next(), idx++) {
-    if (curr->name() == name) {
-      break;
+void ScopeTable::reset(ScopeTable *parent, size_t id) {
+  for (auto i : touched_) {
+    slots_[i].seq = 0;
+  }
+  touched_.clear();
+  id_ = id;
+  size_ = 0;
+  next_seq_ = 1;
+  parent_scope_ = parent;
+}
+
+/* sdbm mixes poorly into the low bits, so spread it with a fibonacci
+ * multiply and take the top bits */
+size_t ScopeTable::home_slot(size_t hash) const {
+  return (uint64_t(hash) * 0x9E3779B97F4A7C15ull) >>
+         (64 - std::countr_zero(capacity_));
+}
+
+/* Returns slot index and current pointer (w.r.t to found node) */
+std::tuple<size_t, SymbolInfo *> ScopeTable::find_helper(Name name) {
+  size_t hash = name.hash();
+  size_t mask = capacity_ - 1;
+  size_t i = home_slot(hash);
+
+  for (; !slots_[i].empty(); i = (i + 1) & mask) {
+    if (slots_[i].hash == hash && slots_[i].symbol.interned_name() == name) {
+      return {i, &slots_[i].symbol};
     }
   }
 
-  assert(!prev || prev->next() == curr);
+  return {i, nullptr};
+}
+
+/* double the slot array, sequence numbers move along so the reported
+ * layout doesn't change */
+void ScopeTable::grow() {
+  auto *old_slots = slots_;
+  auto old_capacity = capacity_;
+
+  capacity_ *= 2;
+  slots_ = allocator_.allocate(capacity_);
+  std::uninitialized_default_construct_n(slots_, capacity_);
 
-  return {h, idx, prev, curr};
+  size_t mask = capacity_ - 1;
+  touched_.clear();
+  for (size_t j = 0; j < old_capacity; j++) {
+    if (old_slots[j].empty()) {
+      continue;
+    }
+    size_t i = home_slot(old_slots[j].hash);
+    while (!slots_[i].empty()) {
+      i = (i + 1) & mask;
+    }
+    slots_[i] = old_slots[j];
+    touched_.push_back(i);
+  }
+
+  allocator_.deallocate(old_slots, old_capacity);
 }
 
-/* Use find helper to avoid recomputing hash */
 bool ScopeTable::insert(std::string_view name, SymbolType type, Decl *decl) {
-  auto [h, i, prev, curr] = find_helper(name);
-  if (!curr) {
-    auto *new_node = symbol_allocator_.allocate(1);
-    std::construct_at(new_node, name, type, decl);
+  return insert(Interner::intern(name), type, decl);
+}
 
-    if (prev) {
-      prev->set_next(new_node);
-    } else {
-      table_[h] = new_node;
-    }
+/* Use find helper to avoid recomputing hash */
+bool ScopeTable::insert(Name name, SymbolType type, Decl *decl) {
+  auto [i, curr] = find_helper(name);
+  if (curr) {
+    return false;
+  }
 
-    // Log::writeln("\tInserted in ScopeTable# {} at position {}, {}", id_, h +
-    // 1,
-    //              i + 1);
+  if ((size_ + 1) * 4 > capacity_ * 3) {
+    grow();
+    i = std::get<0>(find_helper(name));
   }
 
-  return !curr;
+  auto &slot = slots_[i];
+  slot.hash = name.hash();
+  slot.seq = next_seq_++;
+  std::construct_at(&slot.symbol, name, type, decl);
+  size_++;
+  touched_.push_back(i);
+
+  // auto [h, pos] = *position(name);
+  // Log::writeln("\tInserted in ScopeTable# {} at position {}, {}", id_, h +
+  // 1,
+  //              pos + 1);
+
+  return true;
 }
 
-/* Return curr pointer */
+/* A name that was never interned can't be in any table */
 SymbolInfo *ScopeTable::look_up(std::string_view name) {
-  auto [h, i, _, curr] = find_helper(name);
+  auto interned = Interner::find(name);
+  return interned ? look_up(interned) : nullptr;
+}
+
+/* Return curr pointer */
+SymbolInfo *ScopeTable::look_up(Name name) {
+  auto [i, curr] = find_helper(name);
   if (curr) {
+    // auto [h, pos] = *position(name);
     // Log::writeln("\t'{}' found in ScopeTable# {} at position {}, {}", name,
     // id_,
-    //              h + 1, i + 1);
+    //              h + 1, pos + 1);
   }
   return curr;
 }
 
-/* Only delete if curr pointer is found.
-   Previous pointer is used to properly delete. */
 bool ScopeTable::remove(std::string_view name) {
-  auto [h, i, prev, curr] = find_helper(name);
-  if (curr) {
-    if (prev) {
-      prev->set_next(curr->next());
-    }
-    if (table_[h] == curr) {
-      table_[h] = curr->next();
+  auto interned = Interner::find(name);
+  return interned && remove(interned);
+}
+
+/* Only delete if curr pointer is found.
+   Later entries of the probe run are shifted back into the hole, so lookups
+   never need tombstones. */
+bool ScopeTable::remove(Name name) {
+  auto [i, curr] = find_helper(name);
+  if (!curr) {
+    return false;
+  }
+
+  // auto [h, pos] = *position(name);
+  // Log::writeln("\tDeleted '{}' from ScopeTable# {} at position {}, {}",
+  // name,
+  //              id_, h + 1, pos + 1);
+
+  size_t mask = capacity_ - 1;
+  size_t hole = i;
+  for (size_t j = (hole + 1) & mask; !slots_[j].empty(); j = (j + 1) & mask) {
+    size_t home = home_slot(slots_[j].hash);
+    /* entry at j may move to the hole unless its home lies in (hole, j] */
+    bool stays = hole <= j ? (hole < home && home <= j)
+                           : (hole < home || home <= j);
+    if (!stays) {
+      slots_[hole] = slots_[j];
+      hole = j;
     }
+  }
+  slots_[hole].seq = 0;
+  size_--;
 
-    std::destroy_at(curr);
-    symbol_allocator_.deallocate(curr, 1);
+  return true;
+}
 
-    // Log::writeln("\tDeleted '{}' from ScopeTable# {} at position {}, {}",
-    // name,
-    //              id_, h + 1, i + 1);
+/* a symbol's position is the number of symbols in its bucket that were
+ * inserted before it */
+std::optional<std::pair<size_t, size_t>> ScopeTable::position(Name name) {
+  auto [i, curr] = find_helper(name);
+  if (!curr) {
+    return std::nullopt;
   }
-  return curr;
+  size_t h = slots_[i].hash % num_buckets_;
+  size_t pos = 0;
+  for (size_t j = 0; j < capacity_; j++) {
+    if (!slots_[j].empty() && slots_[j].hash % num_buckets_ == h &&
+        slots_[j].seq < slots_[i].seq) {
+      pos++;
+    }
+  }
+  return std::make_pair(h, pos);
 }
 
 void ScopeTable::log(Logger *logger) {
+  if (!logger->enabled()) {
+    return;
+  }
   logger->writeln("\tScopeTable# {}", id_);
-  for (size_t i = 0; i < num_buckets_; i++) {
-    if (table_[i]) {
-      logger->write("\t{}--> ", i + 1);
-      for (SymbolInfo *p = table_[i]; p; p = p->next()) {
-        p->log(logger);
+  if (size_ == 0) {
+    return;
+  }
+
+  /* order by (bucket, insertion), same as walking the old chains */
+  struct Entry {
+    size_t bucket;
+    uint32_t seq;
+    SymbolInfo *symbol;
+  };
+  std::vector<Entry> entries;
+  entries.reserve(size_);
+  for (size_t j = 0; j < capacity_; j++) {
+    if (!slots_[j].empty()) {
+      entries.push_back({slots_[j].hash % num_buckets_, slots_[j].seq,
+                         &slots_[j].symbol});
+    }
+  }
+  std::sort(entries.begin(), entries.end(), [](auto &a, auto &b) {
+    return a.bucket != b.bucket ? a.bucket < b.bucket : a.seq < b.seq;
+  });
+
+  for (size_t k = 0; k < entries.size(); k++) {
+    if (k == 0 || entries[k].bucket != entries[k - 1].bucket) {
+      if (k) {
+        logger->endl();
       }
-      logger->endl();
+      logger->write("\t{}--> ", entries[k].bucket + 1);
     }
+    entries[k].symbol->log(logger);
   }
+  logger->endl();
 }
@@ -1,44 +1,90 @@
 #include <algorithm>
+#include <bit>
 #include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <tuple>
+#include <utility>
+#include <vector>
 
 #include "ast/ast_visitor.h"
 #include "sdbm_hash.h"
 #include "symbol_info.h"
 
+/* Open addressing hash table of symbols (linear probing, backward shift
+ * deletion). Slots hold the hash, the insertion sequence number and the
+ * SymbolInfo itself, so a probe never chases pointers. The table doubles
+ * once it is 3/4 full.
+ *
+ * For reporting, the table still behaves like num_buckets separate chains:
+ * a symbol belongs to bucket (hash % num_buckets) and its position is its
+ * rank by insertion order among the symbols of that bucket. log() prints the
+ * same layout as the old chained table.
+ *
+ * SymbolInfo pointers returned by look_up stay valid until the next insert
+ * or remove on the same scope. */
 class ScopeTable {
 
 public:
-  /* Construct ScopeTable with number of buckets and parent scope as parameter
-   */
-  ScopeTable(size_t num_buckets, ScopeTable *parent = nullptr);
+  /* Construct ScopeTable with number of buckets, parent scope and the id it
+   * is logged with as parameter */
+  ScopeTable(size_t num_buckets, ScopeTable *parent = nullptr, size_t id = 1);
   ~ScopeTable();
 
+  ScopeTable(const ScopeTable &) = delete;
+  ScopeTable &operator=(const ScopeTable &) = delete;
+
+  /* Empty the table for reuse as a new scope, under a new ID. Only slots
+   * written since the last reset are cleared. */
+  void reset(ScopeTable *parent, size_t id);
+
 private:
+  struct Slot {
+    /* raw hash of the name, the name itself is in symbol */
+    size_t hash;
+    /* insertion sequence number, 0 marks an empty slot */
+    uint32_t seq;
+    union {
+      SymbolInfo symbol;
+    };
+
+    Slot() : hash(0), seq(0) {}
+    bool empty() const { return seq == 0; }
+  };
+
+  static_assert(std::is_trivially_destructible_v<SymbolInfo>);
+
   /*
-   * @param std::string_view symbol_name
-   *    Symbol name to look up in the hash table
-
-   * @return (size_t, size_t, SymbolInfo*, SymbolInfo*)
-   *    Returns (hash_value, index, prev_pointer, pointer)
-   *    where index is the index the node in the bucker
-   *    Where pointer points to SymbolInfo matching symbol_name
-   *    and prev_pointer points to node before it in linked list.
-   *    pointer is null if name is not found.
-   *    prev_pointer is null if pointer is the first node.
+   * @param Name symbol_name
+   *    Interned symbol name to look up in the hash table
+
+   * @return (size_t, SymbolInfo*)
+   *    Returns (slot_index, pointer)
+   *    where pointer points to SymbolInfo matching symbol_name, or is null
+   *    if the name is not found, in which case slot_index is the empty slot
+   *    where it would be inserted.
    */
-  std::tuple<size_t, size_t, SymbolInfo *, SymbolInfo *>
-  find_helper(std::string_view name);
+  std::tuple<size_t, SymbolInfo *> find_helper(Name name);
+
+  size_t home_slot(size_t hash) const;
+  void grow();
 
 public:
   /* Insert symbol into table */
   bool insert(std::string_view name, SymbolType type, Decl *decl);
+  bool insert(Name name, SymbolType type, Decl *decl);
 
   /* Lookup symbol in the table */
   SymbolInfo *look_up(std::string_view name);
+  SymbolInfo *look_up(Name name);
 
   /* Delete symbol from the table if it exists */
   bool remove(std::string_view name);
+  bool remove(Name name);
+
+  /* (bucket, position in bucket) of a symbol, both zero based */
+  std::optional<std::pair<size_t, size_t>> position(Name name);
 
   /* Return number of symbols in table */
   size_t size() const { return size_; }
@@ -53,12 +99,15 @@ public:
   void log(Logger *logger);
 
 private:
-  static inline size_t last_id_ = 1;
-  const size_t id_;
-  std::allocator<SymbolInfo *> allocator_;
-  std::allocator<SymbolInfo> symbol_allocator_;
-  SymbolInfo **table_;
+  size_t id_;
+  std::allocator<Slot> allocator_;
+  Slot *slots_;
+  /* power of two */
+  size_t capacity_;
+  /* slots that were inserted into */
+  std::vector<uint32_t> touched_;
   size_t num_buckets_;
-  size_t size_;
+  size_t size_ = 0;
+  uint32_t next_seq_ = 1;
   ScopeTable *parent_scope_;
 };
@@ -2,7 +2,7 @@
 
 #include <string_view>
 
-inline size_t sdbm_hash(std::string_view str, size_t mod) {
+inline size_t sdbm_hash(std::string_view str) {
   size_t hash = 0;
   size_t i = 0;
   size_t len = str.length();
@@ -11,5 +11,9 @@ inline size_t sdbm_hash(std::string_view str, size_t mod) {
     hash = ((str[i]) + (hash << 6) + (hash << 16) - hash);
   }
 
-  return hash % mod;
+  return hash;
+}
+
+inline size_t sdbm_hash(std::string_view str, size_t mod) {
+  return sdbm_hash(str) % mod;
 }
@@ -0,0 +1,52 @@
+#include "source_buffer.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceBuffer::SourceBuffer(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return;
+  }
+
+  /* Reserve zeroed pages for the file, a possibly missing final newline and
+   * the terminators, and map the file over the front. The rest of the file's
+   * last page reads as zero too, so the terminators are there whether or not
+   * the size is page aligned. */
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t size = st.st_size;
+  size_t mapped_size = (size + 3 + page - 1) / page * page;
+  void *p = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p != MAP_FAILED && size > 0 &&
+      mmap(p, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) ==
+          MAP_FAILED) {
+    munmap(p, mapped_size);
+    p = MAP_FAILED;
+  }
+  close(fd);
+
+  if (p != MAP_FAILED) {
+    data_ = static_cast<char *>(p);
+    size_ = size;
+    mapped_size_ = mapped_size;
+    /* the last line always ends in a newline, so line counts don't depend
+     * on how the file was saved */
+    if (size_ > 0 && data_[size_ - 1] != '\n') {
+      data_[size_++] = '\n';
+    }
+  }
+}
+
+SourceBuffer::~SourceBuffer() {
+  if (data_) {
+    munmap(data_, mapped_size_);
+  }
+}
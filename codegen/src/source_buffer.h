@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+/* Source file mapped into memory for the scanner. The mapping is private
+ * and writable (flex pokes NULs into the buffer while scanning) and is
+ * followed by the two NUL bytes yy_scan_buffer expects, so tokens can point
+ * straight into it. */
+class SourceBuffer {
+public:
+  SourceBuffer(const char *path);
+  ~SourceBuffer();
+
+  SourceBuffer(const SourceBuffer &) = delete;
+  SourceBuffer &operator=(const SourceBuffer &) = delete;
+
+  bool valid() const { return data_; }
+
+  /* file contents, newline terminated unless empty. data()[size()] and
+   * data()[size() + 1] are NUL */
+  char *data() { return data_; }
+  size_t size() const { return size_; }
+
+  std::string_view str() const { return {data_, size_}; }
+
+private:
+  char *data_ = nullptr;
+  size_t size_ = 0;
+  size_t mapped_size_ = 0;
+};
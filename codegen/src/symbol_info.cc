@@ -17,5 +17,5 @@ void SymbolInfo::log(Logger *logger) {
     type_str = "type";
     break;
   }
-  logger->write("<{},{} [{}]>", name_, type_str, decl_->type()->name());
+  logger->write("<{},{} [{}]>", name_.str(), type_str, decl_->type()->name());
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "interner.h"
 #include "log.h"
 #include <iostream>
 #include <string>
@@ -14,12 +15,15 @@ class SymbolInfo {
   friend class SymbolTable;
 
 public:
-  /* Construct SymbolInfo with name and type, next is initialised as null */
-  SymbolInfo(std::string_view name, SymbolType type, Decl *decl)
-      : name_(name), type_(type), decl_(decl), next_(nullptr) {}
+  /* Construct SymbolInfo with name, type and declaration */
+  SymbolInfo(Name name, SymbolType type, Decl *decl)
+      : name_(name), type_(type), decl_(decl) {}
 
   /* Get symbol name */
-  std::string_view name() const { return name_; }
+  std::string_view name() const { return name_.str(); }
+
+  /* Get interned symbol name */
+  Name interned_name() const { return name_; }
 
   /* Get symbol type */
   SymbolType type() const { return type_; }
@@ -31,15 +35,8 @@ public:
   void log(Logger *logger);
 
 private:
-  std::string name_;
+  Name name_;
   SymbolType type_;
 
   Decl *decl_;
-
-  /* for use in symbol and scope table */
-  SymbolInfo *next_;
-  /* Get next symbol in linked list */
-  SymbolInfo *next() const { return next_; }
-  /* Set next symbol in linked list */
-  void set_next(SymbolInfo *next) { next_ = next; }
 };
@@ -1,9 +1,9 @@
 #include "symbol_table.h"
 
 /* set initial bucket size  for all scope tables, set currentScope as null */
-SymbolTable::SymbolTable(size_t init_bucket_size, Logger *logger)
-    : k_init_bucket_size_(init_bucket_size), current_scope_(nullptr),
-      logger_(logger) {
+SymbolTable::SymbolTable(size_t init_bucket_size, Logger *logger, Mode mode)
+    : logger_(logger), k_init_bucket_size_(init_bucket_size), mode_(mode),
+      current_scope_(nullptr) {
   // initialse the global scope
   enter_scope();
   global_scope_ = current_scope_;
@@ -11,38 +11,104 @@ SymbolTable::SymbolTable(size_t init_bucket_size, Logger *logger)
 
 SymbolTable::~SymbolTable() {
   while (current_scope_) {
-    auto *t = current_scope_;
+    free_scopes_.push_back(current_scope_);
     current_scope_ = current_scope_->parent_scope();
+  }
+  for (auto *t : free_scopes_) {
     std::destroy_at(t);
     allocator_.deallocate(t, 1);
   }
 }
 
-/* construct new scope, set current scope as parent */
+/* construct (or recycle) new scope, set current scope as parent */
 void SymbolTable::enter_scope() {
-  auto *new_scope = allocator_.allocate(1);
-  std::construct_at(new_scope, k_init_bucket_size_, current_scope_);
+  ScopeTable *new_scope;
+  if (!free_scopes_.empty()) {
+    new_scope = free_scopes_.back();
+    free_scopes_.pop_back();
+    new_scope->reset(current_scope_, next_scope_id_++);
+  } else {
+    new_scope = allocator_.allocate(1);
+    std::construct_at(new_scope, k_init_bucket_size_, current_scope_,
+                      next_scope_id_++);
+  }
   current_scope_ = new_scope;
+  scope_marks_.push_back(undo_log_.size());
 }
 
-/* destroy current scope, set parent scope as current */
+/* retire current scope, set parent scope as current. Its symbols live in
+ * the table's slots, so there is nothing to free one by one. */
 void SymbolTable::exit_scope() {
   if (!current_scope_->parent_scope()) {
     // cannot make SymbolTable empty
     // Log::writeln("\tScopeTable# {} cannot be removed", current_scope_->id());
     return;
   }
-  auto *t = current_scope_;
+  free_scopes_.push_back(current_scope_);
   current_scope_ = current_scope_->parent_scope();
-  std::destroy_at(t);
-  allocator_.deallocate(t, 1);
+
+  /* unshadow, newest first; removed bindings are already unlinked */
+  for (size_t mark = scope_marks_.back(); undo_log_.size() > mark;) {
+    auto *binding = undo_log_.back();
+    undo_log_.pop_back();
+    if (!binding->removed) {
+      top_binding(binding->symbol.interned_name()) = binding->shadowed;
+    }
+    binding->shadowed = free_bindings_;
+    free_bindings_ = binding;
+  }
+  scope_marks_.pop_back();
+}
+
+SymbolTable::Binding *SymbolTable::new_binding(Name name, SymbolType type,
+                                               Decl *decl, size_t depth,
+                                               Binding *shadowed) {
+  Binding *binding;
+  if (free_bindings_) {
+    binding = free_bindings_;
+    free_bindings_ = binding->shadowed;
+  } else {
+    binding = static_cast<Binding *>(
+        binding_arena_.allocate(sizeof(Binding), alignof(Binding)));
+  }
+  return new (binding) Binding{SymbolInfo(name, type, decl), depth, false,
+                               shadowed};
+}
+
+SymbolTable::Binding *&SymbolTable::top_binding(Name name) {
+  if (name.id() >= bindings_.size()) {
+    bindings_.resize(std::max<size_t>(name.id() + 1, bindings_.size() * 2));
+  }
+  return bindings_[name.id()];
 }
 
 bool SymbolTable::insert(std::string_view name, SymbolType type, Decl *decl) {
+  return insert(Interner::intern(name), type, decl);
+}
+
+bool SymbolTable::insert(Name name, SymbolType type, Decl *decl) {
   assert(current_scope_);
   bool inserted = current_scope_->insert(name, type, decl);
   if (!inserted) {
     // Log::writeln("\t'{}' already exists in the current ScopeTable", name);
+  } else if (mode_ == Mode::FLAT) {
+    auto &top = top_binding(name);
+    top = new_binding(name, type, decl, scope_marks_.size() - 1, top);
+    undo_log_.push_back(top);
+  }
+  return inserted;
+}
+
+/* the global binding goes under any bindings of nested scopes, it is never
+ * undone so it stays out of the undo log */
+bool SymbolTable::insert_global(Name name, SymbolType type, Decl *decl) {
+  bool inserted = global_scope_->insert(name, type, decl);
+  if (inserted && mode_ == Mode::FLAT) {
+    auto *link = &top_binding(name);
+    while (*link && (*link)->depth > 0) {
+      link = &(*link)->shadowed;
+    }
+    *link = new_binding(name, type, decl, 0, *link);
   }
   return inserted;
 }
@@ -52,11 +118,28 @@ bool SymbolTable::remove(std::string_view name) {
   bool removed = removed = current_scope_->remove(name);
   if (!removed) {
     // Log::writeln("\tNot found in the current ScopeTable");
+  } else if (mode_ == Mode::FLAT) {
+    /* it was in the current scope, so it's the innermost binding */
+    auto &top = top_binding(Interner::find(name));
+    top->removed = true;
+    top = top->shadowed;
   }
   return removed;
 }
 
 SymbolInfo *SymbolTable::look_up(std::string_view name) {
+  auto interned = Interner::find(name);
+  return interned ? look_up(interned) : nullptr;
+}
+
+/* name is hashed once, each scope then only compares handles */
+SymbolInfo *SymbolTable::look_up(Name name) {
+  if (mode_ == Mode::FLAT) {
+    auto *binding =
+        name.id() < bindings_.size() ? bindings_[name.id()] : nullptr;
+    return binding ? &binding->symbol : nullptr;
+  }
+
   auto *s = current_scope_;
   while (s) {
     auto *symbol = s->look_up(name);
@@ -1,27 +1,46 @@
 #pragma once
 
+#include <vector>
+
+#include "arena.h"
 #include "scope_table.h"
 #include "symbol_info.h"
 
 class SymbolTable {
 public:
-  SymbolTable(size_t init_bucket_size, Logger *logger);
+  enum class Mode {
+    /* look_up probes every enclosing scope table, innermost first */
+    SCOPE_CHAIN,
+    /* every name also maps to a stack of its visible declarations, so
+     * look_up is a single index no matter how deep the nesting */
+    FLAT,
+  };
+
+  SymbolTable(size_t init_bucket_size, Logger *logger,
+              Mode mode = Mode::SCOPE_CHAIN);
   ~SymbolTable();
 
-  /* enter into new scope, creating new scope table */
+  Mode mode() const { return mode_; }
+
+  /* enter into new scope, reusing a retired scope table if there is one */
   void enter_scope();
 
-  /* leave current scope, deleting table */
+  /* leave current scope, retiring its table */
   void exit_scope();
 
   /* insert symbol into current scope */
   bool insert(std::string_view name, SymbolType type, Decl *decl);
+  bool insert(Name name, SymbolType type, Decl *decl);
+
+  /* insert symbol into global scope, from whatever scope is current */
+  bool insert_global(Name name, SymbolType type, Decl *decl);
 
   /* delete symbol into current scope */
   bool remove(std::string_view name);
 
   /* lookup symbol in all the current scopes */
   SymbolInfo *look_up(std::string_view name);
+  SymbolInfo *look_up(Name name);
 
   ScopeTable *current_scope() { return current_scope_; }
   ScopeTable *global_scope() { return global_scope_; }
@@ -33,10 +52,40 @@ public:
   void log_all_scopes();
 
 private:
+  /* FLAT mode: a declaration visible through the name index. It is a copy
+   * of the symbol in the scope table, which keeps its own for logging. */
+  struct Binding {
+    SymbolInfo symbol;
+    /* nesting depth of the declaring scope, global is 0 */
+    size_t depth;
+    bool removed;
+    /* declaration of the same name in an enclosing scope */
+    Binding *shadowed;
+  };
+
+  Binding *new_binding(Name name, SymbolType type, Decl *decl, size_t depth,
+                       Binding *shadowed);
+  Binding *&top_binding(Name name);
+
   Logger *logger_;
   const size_t k_init_bucket_size_;
+  const Mode mode_;
 
   std::allocator<ScopeTable> allocator_;
   ScopeTable *current_scope_;
   ScopeTable *global_scope_;
+  /* retired scope tables, reused by enter_scope */
+  std::vector<ScopeTable *> free_scopes_;
+  /* scope ids count per table, not per process, so units compiled in one
+   * process log the same ids as when compiled alone */
+  size_t next_scope_id_ = 1;
+
+  /* innermost binding per name, indexed by Name::id */
+  std::vector<Binding *> bindings_;
+  /* bindings in order of insertion, exit_scope pops back to the mark
+   * recorded by the matching enter_scope */
+  std::vector<Binding *> undo_log_;
+  std::vector<size_t> scope_marks_;
+  Binding *free_bindings_ = nullptr;
+  Arena binding_arena_;
 };
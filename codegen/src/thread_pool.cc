@@ -0,0 +1,68 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threads) {
+  for (size_t i = 1; i < threads; i++) {
+    workers_.emplace_back([this] { work(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard lock(mutex_);
+    stop_ = true;
+  }
+  start_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(size_t n, const std::function<void(size_t)> &f) {
+  if (workers_.empty() || n <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      f(i);
+    }
+    return;
+  }
+  {
+    std::lock_guard lock(mutex_);
+    task_ = &f;
+    size_ = n;
+    next_ = 0;
+    pending_ = workers_.size();
+    generation_++;
+  }
+  start_.notify_all();
+  drain();
+
+  std::unique_lock lock(mutex_);
+  done_.wait(lock, [this] { return pending_ == 0; });
+  task_ = nullptr;
+}
+
+void ThreadPool::work() {
+  size_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock lock(mutex_);
+      start_.wait(lock, [&] { return stop_ || generation_ != seen; });
+      if (stop_) {
+        return;
+      }
+      seen = generation_;
+    }
+    drain();
+    {
+      std::lock_guard lock(mutex_);
+      if (--pending_ == 0) {
+        done_.notify_one();
+      }
+    }
+  }
+}
+
+void ThreadPool::drain() {
+  for (size_t i; (i = next_++) < size_;) {
+    (*task_)(i);
+  }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads for data parallel loops. The calling thread
+ * takes part in every run, so a pool of one thread runs everything inline
+ * and never starts a thread. */
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  size_t size() const { return workers_.size() + 1; }
+
+  /* call f(i) for every i in [0, n), concurrently and in no particular
+   * order; returns once all calls have */
+  void run(size_t n, const std::function<void(size_t)> &f);
+
+private:
+  void work();
+  /* take indices of the current run until none is left */
+  void drain();
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable start_, done_;
+  /* bumped by every run, workers wait for it to change */
+  size_t generation_ = 0;
+  /* workers yet to finish the current run */
+  size_t pending_ = 0;
+  bool stop_ = false;
+
+  const std::function<void(size_t)> *task_ = nullptr;
+  size_t size_ = 0;
+  std::atomic<size_t> next_ = 0;
+};
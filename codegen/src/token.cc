@@ -2,15 +2,20 @@
 
 #include <log.h>
 
+#include <array>
+
 #include <parser.tab.h>
 
-Token::Token(int line, Type type, std::string &&str)
-    : line_(line), type_(type), value_(std::move(str)) {}
+Token::Token(int line, Type type, std::string_view str)
+    : line_(line), type_(type), value_(str) {}
+
+Token::Token(int line, Type type, Name name)
+    : line_(line), type_(type), value_(name.str()), name_(name) {}
 
 const char *Token::type_str() const {
-  static bool init = false;
-  static const char *str[1024];
-  if (!init) {
+  /* built once, even with several contexts scanning on different threads */
+  static const auto names = [] {
+    std::array<const char *, 1024> str{};
     str[IF] = "IF";
     str[ELSE] = "ELSE";
     str[FOR] = "FOR";
@@ -51,8 +56,8 @@ const char *Token::type_str() const {
     str[MULTI_LINE_STRING] = "MULTI LINE STRING";
     str[COMMENT] = "SINGLE LINE COMMENT";
     str[MULTI_LINE_COMMENT] = "MULTI LINE COMMENT";
-    init = true;
-  }
+    return str;
+  }();
 
-  return str[type_];
+  return names[type_];
 }
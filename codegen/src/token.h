@@ -3,6 +3,9 @@
 #include <cassert>
 #include <optional>
 #include <string>
+#include <string_view>
+
+#include "interner.h"
 
 /* contdown from 1024 for tokens not generated by bison */
 const int COMMENT = 1023;
@@ -12,11 +15,17 @@ class Token {
 public:
   using Type = int;
 
-  Token(int line, Type type, std::string &&str);
+  /* str must outlive the token, normally it's owned by the parser arena */
+  Token(int line, Type type, std::string_view str);
+  /* identifiers keep their interned name */
+  Token(int line, Type type, Name name);
 
   Type type() const { return type_; }
 
-  std::string value() { return value_; }
+  std::string_view value() { return value_; }
+
+  /* interned name, null for anything but identifiers */
+  Name name() { return name_; }
 
   const char *type_str() const;
 
@@ -24,7 +33,8 @@ public:
 
 private:
   Type type_;
-  std::string value_;
+  std::string_view value_;
+  Name name_;
   int line_;
 };
 